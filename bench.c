@@ -0,0 +1,885 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <limits.h>
+#include <getopt.h>
+#include "libconvcodes.h"
+#include "libturbocodes.h"
+#include "libccsds.h"
+#include "utilities.h"
+#include "perfcounters.h"
+#include "cpudispatch.h"
+#include "colors.h"
+
+#define MAX_LIST 8
+
+// allocation counters: the bench target is linked with --wrap=malloc,calloc,realloc
+// so every allocation made by the library goes through these functions
+static long int allocations = 0;
+
+#ifdef BENCH_COUNT_ALLOCS
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t count, size_t size);
+void *__real_realloc(void *ptr, size_t size);
+
+void *__wrap_malloc(size_t size)
+{
+    allocations++;
+    return __real_malloc(size);
+}
+
+void *__wrap_calloc(size_t count, size_t size)
+{
+    allocations++;
+    return __real_calloc(count, size);
+}
+
+void *__wrap_realloc(void *ptr, size_t size)
+{
+    allocations++;
+    return __real_realloc(ptr, size);
+}
+#endif
+
+// state shared by all the kernels of a (code, multiplier) pair
+typedef struct str_benchdata{
+    t_turbocode *turbo;
+    int *interleaver;
+    int *puncturing_pattern;
+    int iterations;
+    int *packet;
+    int *encoded_upper;
+    double *received;           // noisy turbo codeword
+    double *received_upper;     // noisy codeword of the upper code alone
+    int upper_length;
+    double sigma;
+    double **messages;
+    double *scratch[2];         // caller buffers of the interleaver
+    float *received_upper_f;    // single precision copies
+    float **messages_f;
+    double *batch[CONVCODE_BATCH_LANES];    // frames of the batch Viterbi
+    t_rng rng;
+} t_benchdata;
+
+typedef void (*t_kernel)(t_benchdata *data);
+
+static void bench_convcode_encode(t_benchdata *data)
+{
+    free(convcode_encode(data->packet, data->turbo->packet_length, data->turbo->upper_code));
+}
+
+static void bench_turbo_encode(t_benchdata *data)
+{
+    free(turbo_encode(data->packet, data->turbo));
+}
+
+static void bench_convcode_decode(t_benchdata *data)
+{
+    free(convcode_decode(data->received_upper, data->upper_length, data->turbo->upper_code));
+}
+
+static void bench_convcode_extrinsic(t_benchdata *data)
+{
+    for (int i = 0; i < data->turbo->packet_length; i++) {
+        data->messages[0][i] = log(0.5);
+        data->messages[1][i] = log(0.5);
+    }
+
+    free(convcode_extrinsic(data->received_upper, data->upper_length, &data->messages, data->turbo->upper_code,
+                            data->sigma*data->sigma, 1));
+}
+
+static void bench_message_interleave(t_benchdata *data)
+{
+    message_interleave(&data->messages, data->turbo);
+}
+
+static void bench_message_deinterleave(t_benchdata *data)
+{
+    message_deinterleave(&data->messages, data->turbo);
+}
+
+static void bench_interleave_pair(t_benchdata *data)
+{
+    interleaver_apply_pair(data->turbo->pi, data->scratch, data->messages, INTERLEAVE);
+}
+
+static void bench_deinterleave_pair(t_benchdata *data)
+{
+    interleaver_apply_pair(data->turbo->pi, data->scratch, data->messages, DEINTERLEAVE);
+}
+
+static void bench_turbo_decode(t_benchdata *data)
+{
+    free(turbo_decode(data->received, data->iterations, data->sigma*data->sigma, data->turbo));
+}
+
+static void turbo_set_radix(t_turbocode *turbo, int radix)
+{
+    convcode_set_radix(turbo->upper_code, radix);
+    convcode_set_radix(turbo->lower_code, radix);
+}
+
+static void bench_convcode_decode_r4(t_benchdata *data)
+{
+    turbo_set_radix(data->turbo, 4);
+    bench_convcode_decode(data);
+    turbo_set_radix(data->turbo, 2);
+}
+
+static void bench_convcode_extrinsic_r4(t_benchdata *data)
+{
+    turbo_set_radix(data->turbo, 4);
+    bench_convcode_extrinsic(data);
+    turbo_set_radix(data->turbo, 2);
+}
+
+static void bench_turbo_decode_r4(t_benchdata *data)
+{
+    turbo_set_radix(data->turbo, 4);
+    bench_turbo_decode(data);
+    turbo_set_radix(data->turbo, 2);
+}
+
+static void bench_convcode_extrinsic_mm(t_benchdata *data)
+{
+    convcode_set_schedule(data->turbo->upper_code, BCJR_MIDDLE);
+    bench_convcode_extrinsic(data);
+    convcode_set_schedule(data->turbo->upper_code, BCJR_SEQUENTIAL);
+}
+
+static void bench_convcode_extrinsic_mt(t_benchdata *data)
+{
+    convcode_set_schedule(data->turbo->upper_code, BCJR_MIDDLE_THREADS);
+    bench_convcode_extrinsic(data);
+    convcode_set_schedule(data->turbo->upper_code, BCJR_SEQUENTIAL);
+}
+
+static void bench_convcode_extrinsic_f(t_benchdata *data)
+{
+    for (int i = 0; i < data->turbo->packet_length; i++) {
+        data->messages_f[0][i] = logf(0.5f);
+        data->messages_f[1][i] = logf(0.5f);
+    }
+
+    free(convcode_extrinsic_float(data->received_upper_f, data->upper_length, &data->messages_f,
+                                  data->turbo->upper_code, (float) (data->sigma*data->sigma), 1));
+}
+
+static void bench_turbo_decode_f(t_benchdata *data)
+{
+    turbo_set_single_precision(data->turbo, 1);
+    bench_turbo_decode(data);
+    turbo_set_single_precision(data->turbo, 0);
+}
+
+static void turbo_set_decoder(t_turbocode *turbo, t_siso_decoder decoder)
+{
+    convcode_set_decoder(turbo->upper_code, decoder);
+    convcode_set_decoder(turbo->lower_code, decoder);
+}
+
+static void bench_convcode_extrinsic_prob(t_benchdata *data)
+{
+    turbo_set_decoder(data->turbo, SISO_PROBABILITY);
+    bench_convcode_extrinsic(data);
+    turbo_set_decoder(data->turbo, SISO_LOG_MAP);
+}
+
+static void bench_turbo_decode_prob(t_benchdata *data)
+{
+    turbo_set_decoder(data->turbo, SISO_PROBABILITY);
+    bench_turbo_decode(data);
+    turbo_set_decoder(data->turbo, SISO_LOG_MAP);
+}
+
+static void bench_convcode_extrinsic_sova(t_benchdata *data)
+{
+    turbo_set_decoder(data->turbo, SISO_SOVA);
+    bench_convcode_extrinsic(data);
+    turbo_set_decoder(data->turbo, SISO_LOG_MAP);
+}
+
+static void bench_turbo_decode_sova(t_benchdata *data)
+{
+    turbo_set_decoder(data->turbo, SISO_SOVA);
+    bench_turbo_decode(data);
+    turbo_set_decoder(data->turbo, SISO_LOG_MAP);
+}
+
+static void bench_convcode_decode_batch(t_benchdata *data)
+{
+    int **decoded = convcode_decode_batch(data->batch, CONVCODE_BATCH_LANES, data->upper_length,
+                                          data->turbo->upper_code);
+    for (int f = 0; f < CONVCODE_BATCH_LANES; f++)
+        free(decoded[f]);
+    free(decoded);
+}
+
+static void bench_convcode_encode_generic(t_benchdata *data)
+{
+    convcode_use_kernels(data->turbo->upper_code, 0);
+    bench_convcode_encode(data);
+    convcode_use_kernels(data->turbo->upper_code, 1);
+}
+
+static void bench_convcode_decode_generic(t_benchdata *data)
+{
+    convcode_use_kernels(data->turbo->upper_code, 0);
+    bench_convcode_decode(data);
+    convcode_use_kernels(data->turbo->upper_code, 1);
+}
+
+static void bench_convcode_extrinsic_generic(t_benchdata *data)
+{
+    convcode_use_kernels(data->turbo->upper_code, 0);
+    bench_convcode_extrinsic(data);
+    convcode_use_kernels(data->turbo->upper_code, 1);
+}
+
+// the generated kernels perform the same operations as the generic ones:
+// codewords, decisions and messages must be identical. Returns the number of
+// differences, -1 if the code has no generated kernels
+static int validate_kernels(t_benchdata *data)
+{
+    t_convcode *code = data->turbo->upper_code;/*{{{*/
+    int n = data->turbo->packet_length;
+    int encoded_length = (n + code->memory) * code->components;
+    int differences = 0;
+    int *encoded[2], *decoded[2];
+    double *messages[2][2];
+
+    if (convcode_use_kernels(code, 1))
+        return -1;
+
+    for (int use = 0; use < 2; use++) {
+        convcode_use_kernels(code, use);
+        encoded[use] = convcode_encode(data->packet, n, code);
+        decoded[use] = convcode_decode(data->received_upper, data->upper_length, code);
+
+        for (int i = 0; i < n; i++) {
+            data->messages[0][i] = log(0.5);
+            data->messages[1][i] = log(0.5);
+        }
+        free(convcode_extrinsic(data->received_upper, data->upper_length, &data->messages, code,
+                                data->sigma*data->sigma, 0));
+        for (int u = 0; u < 2; u++) {
+            messages[use][u] = malloc(n * sizeof *messages[use][u]);
+            memcpy(messages[use][u], data->messages[u], n * sizeof *messages[use][u]);
+        }
+    }
+
+    for (int i = 0; i < encoded_length; i++)
+        differences += encoded[0][i] != encoded[1][i];
+
+    for (int i = 0; i < n; i++)
+        differences += (decoded[0][i] != decoded[1][i]) + (messages[0][0][i] != messages[1][0][i]) +
+                       (messages[0][1][i] != messages[1][1][i]);
+
+    for (int use = 0; use < 2; use++) {
+        free(encoded[use]);
+        free(decoded[use]);
+        free(messages[use][0]);
+        free(messages[use][1]);
+    }
+
+    return differences;/*}}}*/
+}
+
+// every lane of the batch Viterbi must decide as convcode_decode on its frame.
+// Returns the number of differing decisions
+static int validate_batch(t_benchdata *data)
+{
+    t_convcode *code = data->turbo->upper_code;/*{{{*/
+    int n = data->turbo->packet_length;
+    int differences = 0;
+
+    // a partial group too: the first frame again
+    double *frames[CONVCODE_BATCH_LANES + 1];
+    for (int f = 0; f < CONVCODE_BATCH_LANES; f++)
+        frames[f] = data->batch[f];
+    frames[CONVCODE_BATCH_LANES] = data->received_upper;
+
+    int **decoded = convcode_decode_batch(frames, CONVCODE_BATCH_LANES + 1, data->upper_length, code);
+    for (int f = 0; f <= CONVCODE_BATCH_LANES; f++) {
+        int *reference = convcode_decode(frames[f], data->upper_length, code);
+        for (int i = 0; i < n; i++)
+            differences += reference[i] != decoded[f][i];
+        free(reference);
+        free(decoded[f]);
+    }
+    free(decoded);
+
+    return differences;/*}}}*/
+}
+
+// the meet in the middle schedules perform the same operations as the
+// sequential one: their messages must be identical. Returns the number of
+// differing messages
+static int validate_schedules(t_benchdata *data)
+{
+    t_convcode *code = data->turbo->upper_code;/*{{{*/
+    int n = data->turbo->packet_length;
+    int differences = 0;
+    double *reference[2];
+
+    for (t_bcjr_schedule schedule = BCJR_SEQUENTIAL; schedule <= BCJR_MIDDLE_THREADS; schedule++) {
+        convcode_set_schedule(code, schedule);
+        for (int i = 0; i < n; i++) {
+            data->messages[0][i] = log(0.5);
+            data->messages[1][i] = log(0.5);
+        }
+        free(convcode_extrinsic(data->received_upper, data->upper_length, &data->messages, code,
+                                data->sigma*data->sigma, 0));
+
+        for (int u = 0; u < 2; u++) {
+            if (schedule == BCJR_SEQUENTIAL) {
+                reference[u] = malloc(n * sizeof *reference[u]);
+                memcpy(reference[u], data->messages[u], n * sizeof *reference[u]);
+            } else {
+                for (int i = 0; i < n; i++)
+                    differences += reference[u][i] != data->messages[u][i];
+            }
+        }
+    }
+    convcode_set_schedule(code, BCJR_SEQUENTIAL);
+
+    free(reference[0]);
+    free(reference[1]);
+    return differences;/*}}}*/
+}
+
+// the radix-4 kernels must reproduce the radix-2 ones: same Viterbi and turbo
+// decisions, same log-likelihood ratios up to rounding. Messages are only
+// defined up to a constant per bit, so ratios are compared. Returns the
+// number of mismatching decisions
+static int validate_radix4(t_benchdata *data, double *max_difference)
+{
+    t_turbocode *turbo = data->turbo;/*{{{*/
+    int n = turbo->packet_length;
+    int mismatches = 0;
+    double *llr[2];
+    int *viterbi[2], *decoded[2];
+
+    for (int r = 0; r < 2; r++) {
+        turbo_set_radix(turbo, r ? 4 : 2);
+        for (int i = 0; i < n; i++) {
+            data->messages[0][i] = log(0.5);
+            data->messages[1][i] = log(0.5);
+        }
+        free(convcode_extrinsic(data->received_upper, data->upper_length, &data->messages, turbo->upper_code,
+                                data->sigma*data->sigma, 0));
+
+        llr[r] = malloc(n * sizeof *llr[r]);
+        for (int i = 0; i < n; i++)
+            llr[r][i] = data->messages[1][i] - data->messages[0][i];
+
+        viterbi[r] = convcode_decode(data->received_upper, data->upper_length, turbo->upper_code);
+        decoded[r] = turbo_decode(data->received, data->iterations, data->sigma*data->sigma, turbo);
+    }
+    turbo_set_radix(turbo, 2);
+
+    *max_difference = 0;
+    for (int i = 0; i < n; i++) {
+        double difference = fabs(llr[0][i] - llr[1][i]);
+        *max_difference = difference > *max_difference ? difference : *max_difference;
+        mismatches += (viterbi[0][i] != viterbi[1][i]) + (decoded[0][i] != decoded[1][i]);
+    }
+
+    for (int r = 0; r < 2; r++) {
+        free(llr[r]);
+        free(viterbi[r]);
+        free(decoded[r]);
+    }
+
+    return mismatches;/*}}}*/
+}
+
+
+// single precision can't match double precision exactly: report how far its
+// log-likelihood ratios are from the double ones and how many turbo decisions
+// differ. Returns the number of differing decisions
+static int compare_float(t_benchdata *data, double *max_difference)
+{
+    t_turbocode *turbo = data->turbo;/*{{{*/
+    int n = turbo->packet_length;
+    int mismatches = 0;
+
+    for (int i = 0; i < n; i++) {
+        data->messages[0][i] = log(0.5);
+        data->messages[1][i] = log(0.5);
+    }
+    free(convcode_extrinsic(data->received_upper, data->upper_length, &data->messages, turbo->upper_code,
+                            data->sigma*data->sigma, 0));
+    bench_convcode_extrinsic_f(data);
+
+    *max_difference = 0;
+    for (int i = 0; i < n; i++) {
+        double difference = fabs((data->messages[1][i] - data->messages[0][i]) -
+                                 (data->messages_f[1][i] - data->messages_f[0][i]));
+        *max_difference = difference > *max_difference ? difference : *max_difference;
+    }
+
+    int *decoded[2];
+    for (int single = 0; single < 2; single++) {
+        turbo_set_single_precision(turbo, single);
+        decoded[single] = turbo_decode(data->received, data->iterations, data->sigma*data->sigma, turbo);
+    }
+    turbo_set_single_precision(turbo, 0);
+
+    for (int i = 0; i < n; i++)
+        mismatches += decoded[0][i] != decoded[1][i];
+
+    free(decoded[0]);
+    free(decoded[1]);
+    return mismatches;/*}}}*/
+}
+
+// the other constituent decoders against the log-domain one: the probability
+// domain decoder is exact too but rounds differently, the SOVA approximates.
+// Returns the number of differing turbo decisions
+static int compare_decoder(t_benchdata *data, t_siso_decoder decoder, double *max_difference)
+{
+    t_turbocode *turbo = data->turbo;/*{{{*/
+    int n = turbo->packet_length;
+    int mismatches = 0;
+    double *llr[2];
+    int *decoded[2];
+    t_siso_decoder decoders[2] = {SISO_LOG_MAP, decoder};
+
+    for (int d = 0; d < 2; d++) {
+        turbo_set_decoder(turbo, decoders[d]);
+        for (int i = 0; i < n; i++) {
+            data->messages[0][i] = log(0.5);
+            data->messages[1][i] = log(0.5);
+        }
+        free(convcode_extrinsic(data->received_upper, data->upper_length, &data->messages, turbo->upper_code,
+                                data->sigma*data->sigma, 0));
+
+        llr[d] = malloc(n * sizeof *llr[d]);
+        for (int i = 0; i < n; i++)
+            llr[d][i] = data->messages[1][i] - data->messages[0][i];
+
+        decoded[d] = turbo_decode(data->received, data->iterations, data->sigma*data->sigma, turbo);
+    }
+    turbo_set_decoder(turbo, SISO_LOG_MAP);
+
+    *max_difference = 0;
+    for (int i = 0; i < n; i++) {
+        double difference = fabs(llr[0][i] - llr[1][i]);
+        *max_difference = difference > *max_difference ? difference : *max_difference;
+        mismatches += decoded[0][i] != decoded[1][i];
+    }
+
+    for (int d = 0; d < 2; d++) {
+        free(llr[d]);
+        free(decoded[d]);
+    }
+
+    return mismatches;/*}}}*/
+}
+
+static void bench_randn(t_benchdata *data)
+{
+    free(randn(0, 1, data->turbo->encoded_length));
+}
+
+static void bench_randbits(t_benchdata *data)
+{
+    free(randbits(data->turbo->packet_length));
+}
+
+static void bench_randn_r(t_benchdata *data)
+{
+    free(randn_r(&data->rng, 0, 1, data->turbo->encoded_length));
+}
+
+static void bench_randbits_r(t_benchdata *data)
+{
+    free(randbits_r(&data->rng, data->turbo->packet_length));
+}
+
+// trellis edges visited in a call, one per branch of each trellis section
+static double trellis_edges(t_benchdata *data)
+{
+    t_convcode *code = data->turbo->upper_code;
+    return 2.0 * (2 << (code->memory - 1)) * (data->turbo->packet_length + code->memory);
+}
+
+static double turbo_edges(t_benchdata *data)
+{
+    return 2 * data->iterations * trellis_edges(data);
+}
+
+static double batch_edges(t_benchdata *data)
+{
+    return CONVCODE_BATCH_LANES * trellis_edges(data);
+}
+
+typedef struct str_benchmark{
+    char *name;
+    t_kernel kernel;
+    int per_code;   // 0 if the kernel does not depend on the code rate
+    double (*edges)(t_benchdata *data);
+    int frames;     // frames decoded per call, 0 for one
+} t_benchmark;
+
+static t_benchmark benchmarks[] = {
+        {"convcode_encode",         bench_convcode_encode,      1,  NULL},
+        {"turbo_encode",            bench_turbo_encode,         1,  NULL},
+        {"convcode_decode",         bench_convcode_decode,      1,  trellis_edges},
+        {"convcode_extrinsic",      bench_convcode_extrinsic,   1,  trellis_edges},
+        {"message_interleave",      bench_message_interleave,   0,  NULL},
+        {"message_deinterleave",    bench_message_deinterleave, 0,  NULL},
+        {"interleave_pair",         bench_interleave_pair,      0,  NULL},
+        {"deinterleave_pair",       bench_deinterleave_pair,    0,  NULL},
+        {"randn",                   bench_randn,                1,  NULL},
+        {"randbits",                bench_randbits,             0,  NULL},
+        {"randn_r",                 bench_randn_r,              1,  NULL},
+        {"randbits_r",              bench_randbits_r,           0,  NULL},
+        {"turbo_decode",            bench_turbo_decode,         1,  turbo_edges},
+        {"convcode_decode_r4",      bench_convcode_decode_r4,   1,  trellis_edges},
+        {"convcode_extrinsic_r4",   bench_convcode_extrinsic_r4, 1, trellis_edges},
+        {"turbo_decode_r4",         bench_turbo_decode_r4,      1,  turbo_edges},
+        {"convcode_extrinsic_mm",   bench_convcode_extrinsic_mm, 1, trellis_edges},
+        {"convcode_extrinsic_mt",   bench_convcode_extrinsic_mt, 1, trellis_edges},
+        {"convcode_encode_gen",     bench_convcode_encode_generic, 1, NULL},
+        {"convcode_decode_gen",     bench_convcode_decode_generic, 1, trellis_edges},
+        {"convcode_extrinsic_gen",  bench_convcode_extrinsic_generic, 1, trellis_edges},
+        {"convcode_extrinsic_f",    bench_convcode_extrinsic_f, 1,  trellis_edges},
+        {"turbo_decode_f",          bench_turbo_decode_f,       1,  turbo_edges},
+        {"convcode_extrinsic_prob", bench_convcode_extrinsic_prob, 1, trellis_edges},
+        {"turbo_decode_prob",       bench_turbo_decode_prob,    1,  turbo_edges},
+        {"convcode_extrinsic_sova", bench_convcode_extrinsic_sova, 1, trellis_edges},
+        {"turbo_decode_sova",       bench_turbo_decode_sova,    1,  turbo_edges},
+        {"convcode_decode_batch",   bench_convcode_decode_batch, 1, batch_edges, CONVCODE_BATCH_LANES},
+};
+
+static double elapsed_seconds(struct timespec *start)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - start->tv_sec) + 1e-9 * (now.tv_nsec - start->tv_nsec);
+}
+
+static void benchdata_initialize(t_benchdata *data, int code_type, int octets, int iterations, double EbN0_dB)
+{
+    // not the shared registry code: the benchmarks switch its decoder options/*{{{*/
+    double rate;
+    data->interleaver = ccsds_interleaver(octets);
+    data->turbo = ccsds_turbocode(code_type, octets, data->interleaver, &rate, &data->puncturing_pattern);
+    data->iterations = iterations;
+    data->sigma = sqrt(1.0/(pow(10, EbN0_dB/10.0)*2*rate));
+
+    // fixed seed: every run sees the same packets and noise
+    rng_seed(&data->rng, 1, 0);
+    srand(1);
+
+    t_turbocode *turbo = data->turbo;
+    data->packet = randbits_r(&data->rng, turbo->packet_length);
+
+    int *encoded = turbo_encode(data->packet, turbo);
+    double *noise = randn_r(&data->rng, 0, 1, turbo->encoded_length);
+    data->received = malloc(turbo->encoded_length * sizeof *data->received);
+    for (int i = 0; i < turbo->encoded_length; i++) {
+        int mask = data->puncturing_pattern ? data->puncturing_pattern[i] : 1;
+        data->received[i] = mask * ((2*encoded[i] - 1) + data->sigma*noise[i]);
+    }
+
+    data->encoded_upper = convcode_encode(data->packet, turbo->packet_length, turbo->upper_code);
+    data->upper_length = turbo->upper_code->components * (turbo->packet_length + turbo->upper_code->memory);
+    data->received_upper = malloc(data->upper_length * sizeof *data->received_upper);
+    for (int i = 0; i < data->upper_length; i++)
+        data->received_upper[i] = (2*data->encoded_upper[i] - 1) + data->sigma*noise[i];
+
+    for (int f = 0; f < CONVCODE_BATCH_LANES; f++) {
+        double *lane_noise = randn_r(&data->rng, 0, 1, data->upper_length);
+        data->batch[f] = malloc(data->upper_length * sizeof *data->batch[f]);
+        for (int i = 0; i < data->upper_length; i++)
+            data->batch[f][i] = (2*data->encoded_upper[i] - 1) + data->sigma*lane_noise[i];
+        free(lane_noise);
+    }
+
+    data->received_upper_f = malloc(data->upper_length * sizeof *data->received_upper_f);
+    for (int i = 0; i < data->upper_length; i++)
+        data->received_upper_f[i] = (float) data->received_upper[i];
+
+    data->messages = malloc(2 * sizeof *data->messages);
+    data->messages_f = malloc(2 * sizeof *data->messages_f);
+    for (int i = 0; i < 2; i++) {
+        data->messages[i] = malloc(turbo->packet_length * sizeof(double));
+        data->scratch[i] = malloc(turbo->packet_length * sizeof(double));
+        data->messages_f[i] = malloc(turbo->packet_length * sizeof(float));
+        for (int j = 0; j < turbo->packet_length; j++)
+            data->messages[i][j] = log(0.5);
+    }
+
+    free(encoded);
+    free(noise);/*}}}*/
+}
+
+static void benchdata_clear(t_benchdata *data)
+{
+    ccsds_turbocode_clear(data->turbo);/*{{{*/
+    free(data->interleaver);
+    free(data->puncturing_pattern);
+    free(data->packet);
+    free(data->encoded_upper);
+    free(data->received);
+    free(data->received_upper);
+    free(data->scratch[0]);
+    free(data->scratch[1]);
+    free(data->messages[0]);
+    free(data->messages[1]);
+    free(data->messages);
+    free(data->received_upper_f);
+    for (int f = 0; f < CONVCODE_BATCH_LANES; f++)
+        free(data->batch[f]);
+    free(data->messages_f[0]);
+    free(data->messages_f[1]);
+    free(data->messages_f);/*}}}*/
+}
+
+int main(int argc, char *argv[])
+{
+    int code_types[MAX_LIST] = {1, 2, 3, 4};
+    int codes_count = 4;
+    int octets[MAX_LIST] = {1, 2, 4, 8};
+    int octets_count = 4;
+    int iterations = 2;
+    double min_time = 0.2;
+    double EbN0_dB = 1;
+    char *filter = NULL;
+    int perf_flag = 0;
+    char filename[PATH_MAX] = "bench.csv";
+
+    // parse command line arguments
+    int c;
+    while (1)
+    {
+        static struct option long_options[] =
+                {
+                        {"output",      required_argument,  0,  'o'},
+                        {"code",        required_argument,  0,  't'},
+                        {"multiplier",  required_argument,  0,  'k'},
+                        {"iterations",  required_argument,  0,  'i'},
+                        {"min-time",    required_argument,  0,  'T'},
+                        {"SNR",         required_argument,  0,  's'},
+                        {"filter",      required_argument,  0,  'f'},
+                        {"perf",        no_argument,        0,  'p'},
+                        {"help",        no_argument,        0,  'h'},
+                        {0, 0, 0, 0}
+                };
+
+        int option_index = 0;
+        c = getopt_long(argc, argv, "hpo:t:k:i:T:s:f:", long_options, &option_index);
+
+        if (c == -1)
+            break;
+
+        switch (c)
+        {
+            case 'o':
+                strcpy(filename, optarg);
+                break;
+
+            case 't':
+                codes_count = parse_list(optarg, code_types, MAX_LIST);
+                break;
+
+            case 'k':
+                octets_count = parse_list(optarg, octets, MAX_LIST);
+                break;
+
+            case 'i':
+                iterations = (int) strtol(optarg, NULL, 10);
+                break;
+
+            case 'T':
+                min_time = strtod(optarg, NULL);
+                break;
+
+            case 's':
+                EbN0_dB = strtod(optarg, NULL);
+                break;
+
+            case 'f':
+                filter = optarg;
+                break;
+
+            case 'p':
+                perf_flag = 1;
+                break;
+
+            case 'h':
+                printf(BOLDMAGENTA "%20s" RESET "\n\t%s\n\n", "-o / --output FILENAME", "save results in a comma-separated"
+                        " format in FILENAME (default bench.csv).");
+                printf(BOLDMAGENTA "%20s" RESET "\n\t%s\n\n", "-t / --code LIST", "codes to benchmark, i.e. 1,2,3,4.");
+                printf(BOLDMAGENTA "%20s" RESET "\n\t%s\n\n", "-k / --multiplier LIST", "packet length multipliers, i.e. 1,2,4,8.");
+                printf(BOLDMAGENTA "%20s" RESET "\n\t%s\n\n", "-i / --iterations INTEGER", "iterations of turbo_decode.");
+                printf(BOLDMAGENTA "%20s" RESET "\n\t%s\n\n", "-T / --min-time FLOAT", "minimum time in seconds spent on"
+                        " each benchmark.");
+                printf(BOLDMAGENTA "%20s" RESET "\n\t%s\n\n", "-s / --SNR FLOAT", "Eb/N0 in dB of the decoded frames.");
+                printf(BOLDMAGENTA "%20s" RESET "\n\t%s\n\n", "-f / --filter STRING", "only run benchmarks whose name"
+                        " contains STRING.");
+                printf(BOLDMAGENTA "%20s" RESET "\n\t%s\n\n", "-p / --perf", "sample hardware performance counters"
+                        " and add IPC, cycles per trellis edge and misses per bit to the results.");
+                exit(EXIT_SUCCESS);
+
+            default:
+                abort();
+        }
+    }
+
+    FILE *file = fopen(filename, "w");
+    if (!file){
+        perror("Something went wrong. Couldn't create output file");
+        exit(EXIT_FAILURE);
+    }
+
+    // hardware counters of the main thread, left out if the PMU is not accessible
+    t_perfcounters counters;
+    if (perf_flag && !perf_open(&counters)) {
+        printf(BOLDRED "Hardware performance counters are not available, --perf is ignored.\n" RESET);
+        perf_flag = 0;
+    }
+
+    // radix-4 kernels, BCJR schedules, generated kernels and the batch Viterbi
+    // are only timed if they match the radix-2 sequential generic ones
+    for (int o = 0; o < octets_count; o++) {
+        for (int t = 0; t < codes_count; t++) {
+            t_benchdata data;
+            double difference;
+            benchdata_initialize(&data, code_types[t], octets[o], iterations, EbN0_dB);
+            int mismatches = validate_radix4(&data, &difference);
+            int differences = validate_schedules(&data);
+            int kernel_differences = validate_kernels(&data);
+            int batch_differences = validate_batch(&data);
+            double float_difference;
+            int float_mismatches = compare_float(&data, &float_difference);
+            double probability_difference, sova_difference;
+            int probability_mismatches = compare_decoder(&data, SISO_PROBABILITY, &probability_difference);
+            int sova_mismatches = compare_decoder(&data, SISO_SOVA, &sova_difference);
+            benchdata_clear(&data);
+
+            printf("radix-4 check, code %d, k %d: max LLR difference %.3e, %d mismatching decisions\n",
+                   code_types[t], octets[o], difference, mismatches);
+            printf("single precision, code %d, k %d: max LLR difference %.3e, %d differing turbo decisions\n",
+                   code_types[t], octets[o], float_difference, float_mismatches);
+            printf("probability domain, code %d, k %d: max LLR difference %.3e, %d differing turbo decisions\n",
+                   code_types[t], octets[o], probability_difference, probability_mismatches);
+            printf("SOVA, code %d, k %d: max LLR difference %.3e, %d differing turbo decisions\n",
+                   code_types[t], octets[o], sova_difference, sova_mismatches);
+            if (mismatches || difference > 1e-6){
+                printf(BOLDRED "Radix-4 decoders do not match the radix-2 ones.\n" RESET);
+                exit(EXIT_FAILURE);
+            }
+
+            if (differences){
+                printf(BOLDRED "Meet in the middle BCJR differs in %d messages from the sequential one.\n" RESET,
+                       differences);
+                exit(EXIT_FAILURE);
+            }
+
+            if (batch_differences){
+                printf(BOLDRED "Batch Viterbi differs in %d decisions from convcode_decode.\n" RESET,
+                       batch_differences);
+                exit(EXIT_FAILURE);
+            }
+
+            if (kernel_differences > 0){
+                printf(BOLDRED "Generated kernels differ in %d values from the generic ones.\n" RESET,
+                       kernel_differences);
+                exit(EXIT_FAILURE);
+            }
+        }
+    }
+    printf("Timing the " BOLDMAGENTA "%s" RESET " kernels, set DEEPSPACE_ISA to select another level.\n\n",
+           cpu_isa_name(cpu_isa_selected));
+
+    fprintf(file, "kernel,code,k,bits,calls,ns_per_bit,mbps,allocs_per_call%s\n", perf_flag ? ",ipc,cycles_per_bit,"
+            "cycles_per_edge,l1d_misses_per_bit,l2_misses_per_bit,llc_misses_per_bit,branch_misses_per_bit" : "");
+    printf(BOLDYELLOW "%-24s%6s%4s%10s%10s%14s%12s%14s" RESET, "kernel", "code", "k", "bits", "calls",
+           "ns/bit", "Mbps", "allocs/call");
+    if (perf_flag)
+        printf(BOLDYELLOW "%8s%14s%14s%14s" RESET, "IPC", "cycles/edge", "L1D miss/bit", "LLC miss/bit");
+    printf("\n");
+
+    int benchmarks_count = sizeof(benchmarks) / sizeof(benchmarks[0]);
+    for (int o = 0; o < octets_count; o++) {
+        for (int t = 0; t < codes_count; t++) {
+            t_benchdata data;
+            benchdata_initialize(&data, code_types[t], octets[o], iterations, EbN0_dB);
+            for (int b = 0; b < benchmarks_count; b++) {
+                t_benchmark *bench = &benchmarks[b];
+                int bits = data.turbo->packet_length * (bench->frames ? bench->frames : 1);
+
+                // rate-independent kernels are only run with the first code
+                if ((!bench->per_code && t) || (filter && !strstr(bench->name, filter)))
+                    continue;
+
+                // warm up, then repeat until min_time has elapsed
+                bench->kernel(&data);
+
+                long int calls = 0;
+                long int allocated = allocations;
+                uint64_t before[PERF_EVENTS], after[PERF_EVENTS];
+                if (perf_flag)
+                    perf_read(&counters, before);
+                struct timespec start;
+                clock_gettime(CLOCK_MONOTONIC, &start);
+                double elapsed;
+                do {
+                    bench->kernel(&data);
+                    calls++;
+                    elapsed = elapsed_seconds(&start);
+                } while (elapsed < min_time);
+
+                if (perf_flag)
+                    perf_read(&counters, after);
+
+                double ns_per_bit = 1e9 * elapsed / calls / bits;
+                double mbps = 1e3 / ns_per_bit;
+                double allocs_per_call = (double) (allocations - allocated) / calls;
+                int code_column = bench->per_code ? code_types[t] : 0;
+
+                fprintf(file, "%s,%d,%d,%d,%ld,%.6f,%.6f,%.2f", bench->name, code_column, octets[o], bits, calls,
+                        ns_per_bit, mbps, allocs_per_call);
+                printf("%-24s%6d%4d%10d%10ld%14.3f%12.3f%14.2f", bench->name, code_column, octets[o], bits, calls,
+                       ns_per_bit, mbps, allocs_per_call);
+
+                if (perf_flag) {
+                    // per-bit and per-edge rates, NaN for events the PMU does not count
+                    double metrics[PERF_EVENTS];
+                    for (int e = 0; e < PERF_EVENTS; e++)
+                        metrics[e] = counters.fd[e] >= 0 ? (double) (after[e] - before[e]) / calls / bits : NAN;
+                    double ipc = metrics[PERF_INSTRUCTIONS] / metrics[PERF_CYCLES];
+                    double cycles_per_edge = bench->edges ? metrics[PERF_CYCLES] * bits / bench->edges(&data) : NAN;
+
+                    fprintf(file, ",%.4f,%.4f,%.4f,%.6f,%.6f,%.6f,%.6f", ipc, metrics[PERF_CYCLES], cycles_per_edge,
+                            metrics[PERF_L1D_MISSES], metrics[PERF_L2_MISSES], metrics[PERF_LLC_MISSES],
+                            metrics[PERF_BRANCH_MISSES]);
+                    printf("%8.2f%14.3f%14.4f%14.4f", ipc, cycles_per_edge, metrics[PERF_L1D_MISSES],
+                           metrics[PERF_LLC_MISSES]);
+                }
+                fprintf(file, "\n");
+                printf("\n");
+                fflush(file);
+            }
+
+            benchdata_clear(&data);
+        }
+    }
+
+    ccsds_registry_clear();
+
+    if (perf_flag)
+        perf_close(&counters);
+
+    fclose(file);
+    printf(BOLDGREEN "\nResults saved in %s\n" RESET, filename);
+
+    return 0;
+}
@@ -0,0 +1,22 @@
+#ifndef DEEPSPACE_TURBO_CONVKERNELS_H
+#define DEEPSPACE_TURBO_CONVKERNELS_H
+
+#define CONVKERNELS_MAX_COMPONENTS 8
+
+// encoder, Viterbi and BCJR kernels of a code, generated at build time by
+// kernelgen.c with the trellis as constants. They return the same results as
+// convcode_encode, convcode_decode and the sequential radix-2 convcode_extrinsic
+typedef struct str_convkernels{
+    char *backward;
+    char *forward[CONVKERNELS_MAX_COMPONENTS];
+    int components;
+    void (*encode)(int *encoded, int *packet, int packet_length);
+    int *(*decode)(double *received, int length);
+    int *(*extrinsic)(double *received, int length, double **a_priori, double noise_variance, int decision);
+} t_convkernels;
+
+// defined in the generated convkernels.c
+extern t_convkernels convkernels[];
+extern int convkernels_count;
+
+#endif //DEEPSPACE_TURBO_CONVKERNELS_H
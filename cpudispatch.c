@@ -0,0 +1,60 @@
+#include "cpudispatch.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const char *isa_names[ISA_LEVELS] = {"sse2", "sse4.1", "avx2", "avx512"};
+
+// read by every dispatched call, written once before main
+t_isa cpu_isa_selected = ISA_SSE2;
+
+// highest level supported by the CPU and the operating system
+t_isa cpu_isa_detect(void)
+{
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+    __builtin_cpu_init();/*{{{*/
+    if (__builtin_cpu_supports("avx512f"))
+        return ISA_AVX512;
+    if (__builtin_cpu_supports("avx2"))
+        return ISA_AVX2;
+    if (__builtin_cpu_supports("sse4.1"))
+        return ISA_SSE41;/*}}}*/
+#endif
+    return ISA_SSE2;
+}
+
+const char *cpu_isa_name(t_isa isa)
+{
+    return isa >= ISA_SSE2 && isa < ISA_LEVELS ? isa_names[isa] : "unknown";
+}
+
+// use the kernels of level isa, returns -1 if the CPU does not support it
+int cpu_isa_select(t_isa isa)
+{
+    if (isa < ISA_SSE2 || isa > cpu_isa_detect())
+        return -1;
+
+    cpu_isa_selected = isa;
+    return 0;
+}
+
+// runs before main, so threads only ever read the selection
+__attribute__((constructor)) static void cpu_isa_startup(void)
+{
+    cpu_isa_selected = cpu_isa_detect();/*{{{*/
+
+    char *requested = getenv("DEEPSPACE_ISA");
+    if (!requested || !*requested)
+        return;
+
+    for (t_isa isa = ISA_SSE2; isa < ISA_LEVELS; isa++) {
+        if (!strcmp(requested, isa_names[isa])) {
+            if (cpu_isa_select(isa))
+                fprintf(stderr, "DEEPSPACE_ISA: %s is not supported by this CPU, using %s\n", requested,
+                        isa_names[cpu_isa_selected]);
+            return;
+        }
+    }
+
+    fprintf(stderr, "DEEPSPACE_ISA: unknown level \'%s\', using %s\n", requested, isa_names[cpu_isa_selected]);/*}}}*/
+}
@@ -0,0 +1,61 @@
+#ifndef DEEPSPACE_TURBO_CPUDISPATCH_H
+#define DEEPSPACE_TURBO_CPUDISPATCH_H
+
+// instruction set levels the hot kernels are compiled for. The best one the
+// CPU supports is selected at startup, DEEPSPACE_ISA=sse2|sse4.1|avx2|avx512
+// selects a lower one
+typedef enum {
+    ISA_SSE2,
+    ISA_SSE41,
+    ISA_AVX2,
+    ISA_AVX512,
+    ISA_LEVELS
+} t_isa;
+
+extern t_isa cpu_isa_selected;
+
+t_isa cpu_isa_detect(void);
+const char *cpu_isa_name(t_isa isa);
+int cpu_isa_select(t_isa isa);
+
+// ISA_DISPATCH(storage, ret, name, params, args) compiles name##_body, an
+// ISA_BODY function, once per level and defines name calling the selected
+// variant. Bodies are written once, the compiler schedules and vectorizes
+// them for each level. Contraction to FMA is disabled in the build, so all the
+// variants give the same results
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+
+#define ISA_BODY inline __attribute__((always_inline))
+
+#define ISA_VARIANTS(ret, name, params, args) \
+    __attribute__((target("sse2"))) static ret name##_sse2 params { return name##_body args; } \
+    __attribute__((target("sse4.1"))) static ret name##_sse41 params { return name##_body args; } \
+    __attribute__((target("avx2"))) static ret name##_avx2 params { return name##_body args; } \
+    __attribute__((target("avx512f"))) static ret name##_avx512 params { return name##_body args; } \
+    static ret (*const name##_variants[ISA_LEVELS]) params = {name##_sse2, name##_sse41, name##_avx2, \
+                                                              name##_avx512};
+
+#define ISA_DISPATCH(storage, ret, name, params, args) \
+    ISA_VARIANTS(ret, name, params, args) \
+    storage ret name params { return name##_variants[cpu_isa_selected] args; }
+
+// same for functions returning void
+#define ISA_DISPATCH_VOID(storage, name, params, args) \
+    __attribute__((target("sse2"))) static void name##_sse2 params { name##_body args; } \
+    __attribute__((target("sse4.1"))) static void name##_sse41 params { name##_body args; } \
+    __attribute__((target("avx2"))) static void name##_avx2 params { name##_body args; } \
+    __attribute__((target("avx512f"))) static void name##_avx512 params { name##_body args; } \
+    static void (*const name##_variants[ISA_LEVELS]) params = {name##_sse2, name##_sse41, name##_avx2, \
+                                                               name##_avx512}; \
+    storage void name params { name##_variants[cpu_isa_selected] args; }
+
+#else
+
+// other architectures get a single variant
+#define ISA_BODY inline
+#define ISA_DISPATCH(storage, ret, name, params, args) storage ret name params { return name##_body args; }
+#define ISA_DISPATCH_VOID(storage, name, params, args) storage void name params { name##_body args; }
+
+#endif
+
+#endif //DEEPSPACE_TURBO_CPUDISPATCH_H
@@ -0,0 +1,281 @@
+// build-time generator of trellis kernels:
+//
+//   deepspace_kernelgen OUTPUT.c BACKWARD:FORWARD,FORWARD,... ...
+//
+// writes an encoder, a Viterbi decoder and a BCJR decoder for each code, with
+// states, components, connections and outputs as constants and the
+// add-compare-select of every state unrolled. Operations are the ones of the
+// generic kernels in the same order, so results are identical. Decoders are
+// compiled for every instruction set level, see cpudispatch.h
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "libconvcodes.h"
+#include "convkernels.h"
+
+static int pattern(t_convcode *code, int state, int input)
+{
+    int p = 0;/*{{{*/
+    for (int c = 0; c < code->components; c++)
+        p |= code->output[state][input][c] << c;
+    return p;/*}}}*/
+}
+
+static void emit_tables(FILE *out, t_convcode *code, int k)
+{
+    int N_states = 2 << (code->memory - 1);/*{{{*/
+
+    fprintf(out, "static const int next_state_%d[%d][2] = {", k, N_states);
+    for (int s = 0; s < N_states; s++)
+        fprintf(out, "%s{%d, %d}", s ? ", " : "", code->next_state[s][0], code->next_state[s][1]);
+    fprintf(out, "};\n");
+
+    fprintf(out, "static const int pattern_%d[%d][2] = {", k, N_states);
+    for (int s = 0; s < N_states; s++)
+        fprintf(out, "%s{%d, %d}", s ? ", " : "", pattern(code, s, 0), pattern(code, s, 1));
+    fprintf(out, "};\n");
+
+    fprintf(out, "static const int neighbors_%d[%d][2] = {", k, N_states);
+    for (int s = 0; s < N_states; s++)
+        fprintf(out, "%s{%d, %d}", s ? ", " : "", code->neighbors[s][0], code->neighbors[s][1]);
+    fprintf(out, "};\n");
+
+    // input that feeds zeros into the registers, to terminate the trellis
+    fprintf(out, "static const int termination_%d[%d] = {", k, N_states);
+    for (int s = 0; s < N_states; s++) {
+        int input = 0;
+        for (int j = 0; j < code->memory; j++)
+            input = (input + code->backward_connections[j]*get_bit(s, code->memory - 1 - j)) % 2;
+        fprintf(out, "%s%d", s ? ", " : "", input);
+    }
+    fprintf(out, "};\n\n");/*}}}*/
+}
+
+static void emit_encoder(FILE *out, t_convcode *code, int k)
+{
+    int C = code->components;/*{{{*/
+    int M = code->memory;
+
+    fprintf(out, "static void encode_%d(int *encoded, int *packet, int packet_length)\n{\n", k);
+    fprintf(out, "    int state = 0;\n");
+    fprintf(out, "    for (int i = 0; i < packet_length + %d; i++) {\n", M);
+    fprintf(out, "        int input = i < packet_length ? packet[i] : termination_%d[state];\n", k);
+    fprintf(out, "        int p = pattern_%d[state][input];\n", k);
+    for (int c = 0; c < C; c++)
+        fprintf(out, "        encoded[%d*i + %d] = (p >> %d) & 1;\n", C, c, c);
+    fprintf(out, "        state = next_state_%d[state][input];\n", k);
+    fprintf(out, "    }\n}\n\n");/*}}}*/
+}
+
+// branch metrics of every output pattern of a step, as the generic kernels
+// compute them for every branch
+static void emit_patterns(FILE *out, t_convcode *code, char *expression)
+{
+    int C = code->components;/*{{{*/
+    fprintf(out, "        for (int p = 0; p < %d; p++) {\n", 1 << C);
+    fprintf(out, "            double g = 0;\n");
+    for (int c = 0; c < C; c++) {
+        char term[64];
+        snprintf(term, sizeof term, expression, c);
+        fprintf(out, "            g += pow(rho[%d] - %s, 2);\n", c, term);
+    }
+    fprintf(out, "            cost[p] = g;\n        }\n");/*}}}*/
+}
+
+static void emit_viterbi(FILE *out, t_convcode *code, int k)
+{
+    int N_states = 2 << (code->memory - 1);/*{{{*/
+    int C = code->components;
+    int M = code->memory;
+
+    fprintf(out, "static ISA_BODY int *decode_%d_body(double *received, int length)\n{\n", k);
+    fprintf(out, "    int packet_length = length / %d - %d;\n", C, M);
+    fprintf(out, "    int steps = packet_length + %d;\n", M);
+    fprintf(out, "    int *decoded = malloc(packet_length * sizeof *decoded);\n");
+    fprintf(out, "    unsigned char *survivors = malloc(steps * %d);\n", N_states);
+    fprintf(out, "    double metric[%d], tmp[%d], cost[%d];\n", N_states, N_states, 1 << C);
+    fprintf(out, "    for (int s = 0; s < %d; s++)\n        metric[s] = 1e6;\n    metric[0] = 0;\n\n", N_states);
+    fprintf(out, "    for (int i = 0; i < steps; i++) {\n");
+    fprintf(out, "        double *rho = &received[%d*i];\n", C);
+    emit_patterns(out, code, "2*((p >> %d) & 1) + 1");
+    for (int s = 0; s < N_states; s++) {
+        int nA = abs(code->neighbors[s][0]) - 1, uA = code->neighbors[s][0] > 0;
+        int nB = abs(code->neighbors[s][1]) - 1, uB = code->neighbors[s][1] > 0;
+        fprintf(out, "        {\n            double a = cost[%d] + metric[%d];\n", pattern(code, nA, uA), nA);
+        fprintf(out, "            double b = cost[%d] + metric[%d];\n", pattern(code, nB, uB), nB);
+        fprintf(out, "            double m = a > b ? b : a;\n");
+        fprintf(out, "            tmp[%d] = m;\n            survivors[%d*i + %d] = m == b;\n        }\n", s, N_states, s);
+    }
+    fprintf(out, "        double min = tmp[0];\n");
+    fprintf(out, "        for (int s = 0; s < %d; s++)\n            min = min < tmp[s] ? min : tmp[s];\n", N_states);
+    fprintf(out, "        for (int s = 0; s < %d; s++)\n            metric[s] = tmp[s] - min;\n    }\n\n", N_states);
+    fprintf(out, "    int state = 0;\n");
+    fprintf(out, "    for (int i = steps - 1; i >= 0; i--) {\n");
+    fprintf(out, "        int neighbor = neighbors_%d[state][survivors[%d*i + state]];\n", k, N_states);
+    fprintf(out, "        if (i < packet_length)\n            decoded[i] = neighbor > 0;\n");
+    fprintf(out, "        state = abs(neighbor) - 1;\n    }\n\n");
+    fprintf(out, "    free(survivors);\n    return decoded;\n}\n\n");
+    fprintf(out, "ISA_DISPATCH(static, int *, decode_%d, (double *received, int length), (received, length))\n\n", k);/*}}}*/
+}
+
+static void emit_normalize(FILE *out, int N_states, char *messages)
+{
+    fprintf(out, "        double max = %s[0];\n", messages);/*{{{*/
+    fprintf(out, "        for (int s = 0; s < %d; s++)\n            max = %s[s] > max ? %s[s] : max;\n", N_states,
+            messages, messages);
+    fprintf(out, "        for (int s = 0; s < %d; s++)\n            %s[s] -= max;\n", N_states, messages);/*}}}*/
+}
+
+static void emit_bcjr(FILE *out, t_convcode *code, int k)
+{
+    int N_states = 2 << (code->memory - 1);/*{{{*/
+    int C = code->components;
+    int M = code->memory;
+
+    fprintf(out, "static ISA_BODY int *extrinsic_%d_body(double *received, int length, double **a_priori, "
+                 "double noise_variance, int decision)\n{\n", k);
+    fprintf(out, "    int packet_length = length / %d - %d;\n", C, M);
+    fprintf(out, "    int steps = packet_length + %d;\n", M);
+    fprintf(out, "    double *app[2], *extrinsic[2], cost[%d];\n", 1 << C);
+    fprintf(out, "    for (int u = 0; u < 2; u++) {\n");
+    fprintf(out, "        app[u] = malloc(steps * sizeof *app[u]);\n");
+    fprintf(out, "        extrinsic[u] = malloc(steps * sizeof *extrinsic[u]);\n");
+    fprintf(out, "        for (int i = 0; i < steps; i++)\n");
+    fprintf(out, "            app[u][i] = i < packet_length ? a_priori[u][i] : log(0.5);\n    }\n");
+    fprintf(out, "    double *forward = malloc(steps * %d * sizeof *forward);\n", N_states);
+    fprintf(out, "    double *backward = malloc(steps * %d * sizeof *backward);\n\n", N_states);
+
+    // backward recursion
+    fprintf(out, "    double *last = &backward[(steps - 1)*%d];\n", N_states);
+    fprintf(out, "    for (int s = 0; s < %d; s++)\n        last[s] = -1e10;\n    last[0] = 0;\n", N_states);
+    fprintf(out, "    for (int i = steps - 2; i >= 0; i--) {\n");
+    fprintf(out, "        double *rho = &received[%d*(i+1)];\n", C);
+    emit_patterns(out, code, "(2*((p >> %d) & 1) - 1)");
+    fprintf(out, "        for (int p = 0; p < %d; p++)\n            cost[p] = -cost[p]/(2*noise_variance);\n", 1 << C);
+    fprintf(out, "        double a0 = app[0][i+1], a1 = app[1][i+1];\n");
+    fprintf(out, "        double *next = &backward[(i+1)*%d], *current = &backward[i*%d];\n", N_states, N_states);
+    for (int s = 0; s < N_states; s++)
+        fprintf(out, "        current[%d] = exp_sum(exp_sum(-1e10, a0 + next[%d] + cost[%d]), a1 + next[%d] + "
+                     "cost[%d]);\n", s, code->next_state[s][0], pattern(code, s, 0), code->next_state[s][1],
+                pattern(code, s, 1));
+    emit_normalize(out, N_states, "current");
+    fprintf(out, "    }\n\n");
+
+    // forward recursion
+    fprintf(out, "    for (int s = 0; s < %d; s++)\n        forward[s] = -1e10;\n    forward[0] = 0;\n", N_states);
+    fprintf(out, "    for (int i = 1; i < steps; i++) {\n");
+    fprintf(out, "        double *rho = &received[%d*(i-1)];\n", C);
+    emit_patterns(out, code, "(2*((p >> %d) & 1) - 1)");
+    fprintf(out, "        for (int p = 0; p < %d; p++)\n            cost[p] = -cost[p]/(2*noise_variance);\n", 1 << C);
+    fprintf(out, "        double a0 = app[0][i-1], a1 = app[1][i-1];\n");
+    fprintf(out, "        double *previous = &forward[(i-1)*%d], *current = &forward[i*%d];\n", N_states, N_states);
+    for (int s = 0; s < N_states; s++) {
+        fprintf(out, "        current[%d] = -1e10;\n", s);
+        for (int n = 0; n < 2; n++) {
+            int state = abs(code->neighbors[s][n]) - 1, input = code->neighbors[s][n] > 0;
+            fprintf(out, "        current[%d] = exp_sum(current[%d], a%d + previous[%d] + cost[%d]);\n", s, s, input,
+                    state, pattern(code, state, input));
+        }
+    }
+    emit_normalize(out, N_states, "current");
+    fprintf(out, "    }\n\n");
+
+    // extrinsic messages
+    fprintf(out, "    for (int i = 0; i < steps; i++) {\n");
+    fprintf(out, "        double *rho = &received[%d*i];\n", C);
+    emit_patterns(out, code, "(2*((p >> %d) & 1) - 1)");
+    fprintf(out, "        for (int p = 0; p < %d; p++)\n            cost[p] = -cost[p]/(2*noise_variance);\n", 1 << C);
+    fprintf(out, "        double *f = &forward[i*%d], *b = &backward[i*%d];\n", N_states, N_states);
+    for (int u = 0; u < 2; u++) {
+        fprintf(out, "        double E%d = -1e10;\n", u);
+        for (int s = 0; s < N_states; s++)
+            fprintf(out, "        E%d = exp_sum(E%d, f[%d] + b[%d] + cost[%d]);\n", u, u, s, code->next_state[s][u],
+                    pattern(code, s, u));
+        fprintf(out, "        extrinsic[%d][i] = E%d;\n", u, u);
+    }
+    fprintf(out, "        if (i < packet_length) {\n");
+    fprintf(out, "            a_priori[0][i] = E0;\n            a_priori[1][i] = E1;\n        }\n    }\n\n");
+
+    fprintf(out, "    int *decoded = NULL;\n    if (decision) {\n");
+    fprintf(out, "        decoded = malloc(packet_length * sizeof *decoded);\n");
+    fprintf(out, "        for (int i = 0; i < packet_length; i++)\n");
+    fprintf(out, "            decoded[i] = app[1][i] + extrinsic[1][i] > app[0][i] + extrinsic[0][i];\n    }\n\n");
+    fprintf(out, "    for (int u = 0; u < 2; u++) {\n        free(app[u]);\n        free(extrinsic[u]);\n    }\n");
+    fprintf(out, "    free(forward);\n    free(backward);\n    return decoded;\n}\n\n");
+    fprintf(out, "ISA_DISPATCH(static, int *, extrinsic_%d, (double *received, int length, double **a_priori, "
+                 "double noise_variance, int decision), (received, length, a_priori, noise_variance, decision))\n\n", k);/*}}}*/
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc < 2){
+        fprintf(stderr, "usage: %s OUTPUT.c BACKWARD:FORWARD,FORWARD,... ...\n", argv[0]);
+        exit(EXIT_FAILURE);
+    }
+
+    FILE *out = fopen(argv[1], "w");
+    if (!out){
+        perror("Couldn't create the kernels file");
+        exit(EXIT_FAILURE);
+    }
+
+    int codes_count = argc - 2;
+    char *backward[argc];
+    char *forward[argc][CONVKERNELS_MAX_COMPONENTS];
+    int components[argc];
+
+    fprintf(out, "// generated by kernelgen.c, do not edit\n\n");
+    fprintf(out, "#include <stdlib.h>\n#include <math.h>\n#include \"convkernels.h\"\n#include \"cpudispatch.h\"\n\n");
+    fprintf(out, "// same as exp_sum in libconvcodes.c\n");
+    fprintf(out, "static inline double exp_sum(double a, double b)\n{\n");
+    fprintf(out, "    double max = a > b ? a : b;\n    double diff = fabs(a - b);\n");
+    fprintf(out, "    return diff > 37 ? max : max + log1p(exp(-diff));\n}\n\n");
+
+    for (int k = 0; k < codes_count; k++) {
+        char *spec = argv[k + 2];
+        char *colon = strchr(spec, ':');
+        if (!colon){
+            fprintf(stderr, "Invalid code \'%s\', expected BACKWARD:FORWARD,FORWARD,...\n", spec);
+            exit(EXIT_FAILURE);
+        }
+        *colon = '\0';
+        backward[k] = spec;
+
+        components[k] = 0;
+        for (char *f = strtok(colon + 1, ","); f; f = strtok(NULL, ",")) {
+            if (components[k] == CONVKERNELS_MAX_COMPONENTS || strlen(f) != strlen(backward[k]) + 1){
+                fprintf(stderr, "Invalid forward connections \'%s\' for \'%s\'\n", f, backward[k]);
+                exit(EXIT_FAILURE);
+            }
+            forward[k][components[k]++] = f;
+        }
+
+        t_convcode *code = convcode_initialize(forward[k], backward[k], components[k]);
+        fprintf(out, "// backward %s, forward", backward[k]);
+        for (int c = 0; c < components[k]; c++)
+            fprintf(out, " %s", forward[k][c]);
+        fprintf(out, "\n");
+
+        emit_tables(out, code, k);
+        emit_encoder(out, code, k);
+        emit_viterbi(out, code, k);
+        emit_bcjr(out, code, k);
+        convcode_clear(code);
+        free(code);
+    }
+
+    // a trailing empty entry keeps the table valid without codes
+    fprintf(out, "t_convkernels convkernels[] = {\n");
+    for (int k = 0; k < codes_count; k++) {
+        fprintf(out, "        {\"%s\", {", backward[k]);
+        for (int c = 0; c < components[k]; c++)
+            fprintf(out, "%s\"%s\"", c ? ", " : "", forward[k][c]);
+        fprintf(out, "}, %d, encode_%d, decode_%d, extrinsic_%d},\n", components[k], k, k, k);
+    }
+    fprintf(out, "        {NULL, {NULL}, 0, NULL, NULL, NULL}\n};\n\n");
+    fprintf(out, "int convkernels_count = %d;\n", codes_count);
+
+    fclose(out);
+    return 0;
+}
@@ -0,0 +1,309 @@
+#include "libccsds.h"
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <pthread.h>
+
+#define MAX_COMPONENTS 4
+
+// codes built so far, never modified once they are published
+static t_ccsdscode **registry = NULL;
+static int registry_count = 0;
+static pthread_mutex_t registry_lock = PTHREAD_MUTEX_INITIALIZER;
+
+
+// puncturing function: return 1 if bit k has to be punctured
+int ccsds_puncturing(int k){
+
+    int bit_idx = k % 3;
+
+    // bit 0,3,6,... corresponding to systematic output
+    if (!bit_idx)
+        return 1;
+
+    // get block index
+    int block_idx = k / 3;
+
+    // on odd blocks puncture second bit
+    if (block_idx % 2){
+        return bit_idx != 1;
+    }
+
+    // on even blocks puncture third bit
+    return bit_idx != 2;
+}
+
+// build the CCSDS interleaver for packets of 223*8*octets bits
+int *ccsds_interleaver(int octets)
+{
+    int base = 223;
+    int info_length = base * 8 * octets;
+    int p[8] = {31, 37, 43, 47, 53, 59, 61, 67};
+    int k1 = 8;
+    int k2 = base * octets;
+
+    int *pi = malloc(info_length * sizeof *pi);
+
+    // s - 1 = 2*(i*k2 + j) + m: walk i, j and m instead of dividing every
+    // index, and keep p_q*j mod k2 as a running sum
+    for (int i = 0; i < k1/2; ++i) {
+        int t = (19*i + 1) % (k1/2);
+        int q = t % 8 + 1;
+        int step = p[q-1] % k2;
+        int pj = 0;
+
+        for (int j = 0; j < k2; ++j) {
+            for (int m = 0; m < 2; ++m) {
+                int c = pj + 21*m;
+                c = c >= k2 ? c % k2 : c;
+                pi[2*(i*k2 + j) + m] = 2*(t + c*(k1/2) + 1) - m - 1;
+            }
+
+            pj += step;
+            pj = pj >= k2 ? pj - k2 : pj;
+        }
+    }
+
+    return pi;
+}
+
+// build the selected CCSDS code on top of the interleaver pi
+t_turbocode *ccsds_turbocode(int code_type, int octets, int *pi, double *rate, int **puncturing_pattern)
+{
+    int info_length = 223 * 8 * octets;
+
+    // define codes
+    char *forward_upper[MAX_COMPONENTS];
+    char *forward_lower[MAX_COMPONENTS];
+    t_convcode *code1;
+    t_convcode *code2;
+    t_turbocode *turbo = NULL;
+    int N_components_upper = 2;
+    int N_components_lower = 1;
+
+    char *backward;
+    backward = "0011";
+
+    *puncturing_pattern = NULL;
+
+    switch (code_type){
+
+        case 1:
+            N_components_upper = 2;
+            N_components_lower = 1;
+
+
+            forward_upper[0] = "10011"; // systematic output
+            forward_upper[1] = "11011";
+
+            forward_lower[0] = "11011";
+            // need to define puncturing pattern here maybe with a pointer to function
+            // 110 101 110 101 110 101
+
+            code1 = convcode_initialize(forward_upper, backward, N_components_upper);
+            code2 = convcode_initialize(forward_lower, backward, N_components_lower);
+            turbo = turbo_initialize(code1, code2, pi, info_length);
+            *rate = 1.0/2.0;
+
+            *puncturing_pattern = malloc(turbo->encoded_length * sizeof **puncturing_pattern);
+
+            // build puncturing pattern
+            for (int i = 0; i < turbo->encoded_length; ++i) {
+                (*puncturing_pattern)[i] = ccsds_puncturing(i);
+            }
+            break;
+
+        case 2:
+            N_components_upper = 2;
+            N_components_lower = 1;
+
+            forward_upper[0] = "10011"; // systematic output
+            forward_upper[1] = "11011";
+
+            forward_lower[0] = "11011"; // no need for puncturing
+
+            code1 = convcode_initialize(forward_upper, backward, N_components_upper);
+            code2 = convcode_initialize(forward_lower, backward, N_components_lower);
+            turbo = turbo_initialize(code1, code2, pi, info_length);
+            *rate = 1/3.0;
+            break;
+
+        case 3:
+            N_components_upper = 3;
+            N_components_lower = 1;
+
+            forward_upper[0] = "10011"; // systematic output
+            forward_upper[1] = "10101";
+            forward_upper[2] = "11111";
+
+            forward_lower[0] = "11011"; // no need for puncturing
+
+            code1 = convcode_initialize(forward_upper, backward, N_components_upper);
+            code2 = convcode_initialize(forward_lower, backward, N_components_lower);
+            turbo = turbo_initialize(code1, code2, pi, info_length);
+            *rate = 1/4.0;
+            break;
+
+        case 4:
+            N_components_upper = 4;
+            N_components_lower = 2;
+
+            forward_upper[0] = "10011"; // systematic output
+            forward_upper[1] = "11011";
+            forward_upper[2] = "10101";
+            forward_upper[3] = "11111";
+
+            forward_lower[0] = "11011"; // no need for puncturing
+            forward_lower[1] = "11111";
+
+            code1 = convcode_initialize(forward_upper, backward, N_components_upper);
+            code2 = convcode_initialize(forward_lower, backward, N_components_lower);
+            turbo = turbo_initialize(code1, code2, pi, info_length);
+            *rate = 1/6.0;
+            break;
+    }
+
+    return turbo;
+}
+
+void ccsds_turbocode_clear(t_turbocode *turbo)
+{
+    // the interleaver is owned by the caller, it may be shared by several codes
+    interleaver_clear(turbo->pi);
+    free(turbo->pi);
+    convcode_clear(turbo->upper_code);
+    convcode_clear(turbo->lower_code);
+    free(turbo->upper_code);
+    free(turbo->lower_code);
+    free(turbo);
+}
+
+static int options_equal(t_turbooptions *a, t_turbooptions *b)
+{
+    return a->radix == b->radix && a->schedule == b->schedule && a->decoder == b->decoder &&
+           a->sova_window == b->sova_window && a->single_precision == b->single_precision;
+}
+
+static t_ccsdscode *registry_find(int code_type, int octets, char *spec, t_turbooptions *options)
+{
+    for (int n = 0; n < registry_count; n++)
+        if (registry[n]->code_type == code_type && registry[n]->octets == octets &&
+            !strcmp(registry[n]->interleaver_spec, spec) && options_equal(&registry[n]->options, options))
+            return registry[n];
+    return NULL;
+}
+
+// build a code, sharing the interleaver with the codes of the same length,
+// return NULL if the interleaver can't be built or the options are invalid
+static t_ccsdscode *registry_build(int code_type, int octets, char *spec, t_turbooptions *options)
+{
+    int *interleaver = NULL;/*{{{*/
+    for (int n = 0; n < registry_count && !interleaver; n++)
+        if (registry[n]->octets == octets && !strcmp(registry[n]->interleaver_spec, spec))
+            interleaver = registry[n]->interleaver;
+
+    if (!interleaver)
+        interleaver = *spec ? interleaver_parse(spec, 223 * 8 * octets) : ccsds_interleaver(octets);
+
+    if (!interleaver)
+        return NULL;
+
+    t_ccsdscode *code = malloc(sizeof *code);
+    code->code_type = code_type;
+    code->octets = octets;
+    code->interleaver = interleaver;
+    strncpy(code->interleaver_spec, spec, sizeof(code->interleaver_spec) - 1);
+    code->interleaver_spec[sizeof(code->interleaver_spec) - 1] = '\0';
+    code->turbo = ccsds_turbocode(code_type, octets, code->interleaver, &code->rate, &code->puncturing_pattern);
+
+    // the options are part of the key: the code is never modified afterwards
+    code->options = *options;
+    if (turbo_set_options(code->turbo, options)) {
+        ccsds_turbocode_clear(code->turbo);
+        free(code->puncturing_pattern);
+        free(code);
+        code = NULL;
+    }
+
+    // an interleaver no other code uses
+    int shared = 0;
+    for (int n = 0; n < registry_count; n++)
+        shared = shared || registry[n]->interleaver == interleaver;
+    if (!code && !shared)
+        free(interleaver);
+
+    return code;/*}}}*/
+}
+
+// return the code of the given type and multiplier with the default decoder
+// options, building its tables on the first request. Codes are shared
+// read-only: every thread can encode and decode with the same object, and no
+// setter may be called on it. Returns NULL for an unknown code type
+t_ccsdscode *ccsds_code(int code_type, int octets)
+{
+    return ccsds_code_interleaved(code_type, octets, NULL, NULL);
+}
+
+// same as ccsds_code, with the standard interleaver replaced by the one
+// described by spec (see interleaver_parse), NULL for the standard one, and
+// the decoder options given, NULL for the defaults. Each set of options gets
+// its own code. Returns NULL if the interleaver is invalid for this length or
+// the options are invalid
+t_ccsdscode *ccsds_code_interleaved(int code_type, int octets, char *spec, t_turbooptions *options)
+{
+    if (code_type < 1 || code_type > CCSDS_CODE_TYPES || octets <= 0)/*{{{*/
+        return NULL;
+
+    t_turbooptions defaults = TURBO_DEFAULT_OPTIONS;
+    options = options ? options : &defaults;
+    spec = spec ? spec : "";
+    if (strlen(spec) >= sizeof(((t_ccsdscode *) NULL)->interleaver_spec))
+        return NULL;
+
+    pthread_mutex_lock(&registry_lock);
+    t_ccsdscode *code = registry_find(code_type, octets, spec, options);
+    if (!code) {
+        code = registry_build(code_type, octets, spec, options);
+        if (code) {
+            registry = realloc(registry, (registry_count + 1) * sizeof *registry);
+            registry[registry_count++] = code;
+        }
+    }
+    pthread_mutex_unlock(&registry_lock);
+
+    return code;/*}}}*/
+}
+
+// build every code of the standard up front, i.e. before serving requests
+void ccsds_registry_build(void)
+{
+    int octets[] = CCSDS_OCTETS;
+    for (int o = 0; o < (int) (sizeof(octets) / sizeof(octets[0])); o++)
+        for (int t = 1; t <= CCSDS_CODE_TYPES; t++)
+            ccsds_code(t, octets[o]);
+}
+
+// release every code: no code of the registry may be in use
+void ccsds_registry_clear(void)
+{
+    pthread_mutex_lock(&registry_lock);/*{{{*/
+    for (int n = 0; n < registry_count; n++) {
+        t_ccsdscode *code = registry[n];
+
+        // the last code of a length releases the shared interleaver
+        int shared = 0;
+        for (int m = n + 1; m < registry_count; m++)
+            shared = shared || registry[m]->interleaver == code->interleaver;
+        if (!shared)
+            free(code->interleaver);
+
+        ccsds_turbocode_clear(code->turbo);
+        free(code->puncturing_pattern);
+        free(code);
+    }
+
+    free(registry);
+    registry = NULL;
+    registry_count = 0;
+    pthread_mutex_unlock(&registry_lock);/*}}}*/
+}
@@ -0,0 +1,36 @@
+#ifndef DEEPSPACE_TURBO_LIBCCSDS_H
+#define DEEPSPACE_TURBO_LIBCCSDS_H
+
+#include "libconvcodes.h"
+#include "libturbocodes.h"
+
+// codes of the CCSDS 131.0-B-2 standard: code_type is 1 for R=1/2, 2 for R=1/3,
+// 3 for R=1/4 and 4 for R=1/6, packets are 223 * 8 * octets bits long
+#define CCSDS_CODE_TYPES 4
+#define CCSDS_OCTETS {1, 2, 4, 5}
+
+// a code with its tables: trellis, interleaver and its inverse, puncturing
+// pattern (NULL when nothing is punctured), and the decoder options it was
+// built with
+typedef struct str_ccsdscode{
+    int code_type;
+    int octets;
+    double rate;
+    int *interleaver;
+    char interleaver_spec[256];     // empty for the standard interleaver
+    int *puncturing_pattern;
+    t_turbooptions options;
+    t_turbocode *turbo;
+} t_ccsdscode;
+
+t_ccsdscode *ccsds_code(int code_type, int octets);
+t_ccsdscode *ccsds_code_interleaved(int code_type, int octets, char *spec, t_turbooptions *options);
+void ccsds_registry_build(void);
+void ccsds_registry_clear(void);
+
+int ccsds_puncturing(int k);
+int *ccsds_interleaver(int octets);
+t_turbocode *ccsds_turbocode(int code_type, int octets, int *pi, double *rate, int **puncturing_pattern);
+void ccsds_turbocode_clear(t_turbocode *turbo);
+
+#endif //DEEPSPACE_TURBO_LIBCCSDS_H
@@ -5,7 +5,11 @@
 #include <stdlib.h>
 #include <string.h>
 #include <math.h>
+#include <omp.h>
 #include "libconvcodes.h"
+#include "cpudispatch.h"
+#include "profiling.h"
+#include "perfcounters.h"
 
 int get_bit(int num, int position)
 {
@@ -145,9 +149,130 @@ t_convcode *convcode_initialize(char *forward[], char *backward, int N_component
     }
     code->output = output;
 
+    // merge two steps: each state has four two-step branches in and out
+    code->radix = 2;
+    code->schedule = BCJR_SEQUENTIAL;
+    code->decoder = SISO_LOG_MAP;
+    code->sova_window = SOVA_DEFAULT_WINDOW;
+    code->branches_to = malloc(4 * N_states * sizeof *code->branches_to);
+    code->branches_from = malloc(4 * N_states * sizeof *code->branches_from);
+    int *incoming = calloc(N_states, sizeof *incoming);
+    for (int s = 0; s < N_states; s++) {
+        for (int q = 0; q < 4; q++) {
+            t_branch4 branch;
+            branch.from = s;
+            branch.u0 = q >> 1;
+            branch.u1 = q & 1;
+            int middle = next_state[s][branch.u0];
+            branch.to = next_state[middle][branch.u1];
+            branch.first = 0;
+            branch.second = 0;
+            for (int c = 0; c < N_components; c++) {
+                branch.first |= output[s][branch.u0][c] << c;
+                branch.second |= output[middle][branch.u1][c] << c;
+            }
+
+            code->branches_from[4*s + q] = branch;
+            code->branches_to[4*branch.to + incoming[branch.to]++] = branch;
+        }
+    }
+    free(incoming);
+
+    code->kernels = NULL;
+    convcode_use_kernels(code, 1);
+
     return code;/*}}}*/
 }
 
+// generated kernels of the code, matched on the connection strings
+static t_convkernels *kernels_find(t_convcode *code)
+{
+#ifdef CONVCODES_NO_KERNELS
+    return NULL;
+#else
+    for (int k = 0; k < convkernels_count; k++) {/*{{{*/
+        t_convkernels *kernels = &convkernels[k];
+        int match = kernels->components == code->components && strlen(kernels->backward) == code->memory;
+
+        for (int j = 0; j < code->memory && match; j++)
+            match = kernels->backward[j] - '0' == code->backward_connections[j];
+
+        for (int c = 0; c < code->components && match; c++)
+            for (int j = 0; j <= code->memory && match; j++)
+                match = kernels->forward[c][j] - '0' == code->forward_connections[c][j];
+
+        if (match)
+            return kernels;
+    }
+
+    return NULL;/*}}}*/
+#endif
+}
+
+// switch between the generated kernels and the generic ones, which
+// convcode_initialize picks by default. Returns -1 if the code has none
+int convcode_use_kernels(t_convcode *code, int use)
+{
+    t_convkernels *kernels = kernels_find(code);
+    code->kernels = use ? kernels : NULL;
+
+    return kernels ? 0 : -1;
+}
+
+// select how many branches per state the decoders process at each step: 2
+// (one trellis step) or 4 (two steps merged). Returns -1 for other values
+int convcode_set_radix(t_convcode *code, int radix)
+{
+    if (radix != 2 && radix != 4)
+        return -1;
+
+    code->radix = radix;
+    return 0;
+}
+
+// select the order of the BCJR recursions, see convcode_extrinsic_middle.
+// Returns -1 for an unknown schedule
+int convcode_set_schedule(t_convcode *code, t_bcjr_schedule schedule)
+{
+    if (schedule < BCJR_SEQUENTIAL || schedule > BCJR_MIDDLE_THREADS)
+        return -1;
+
+    code->schedule = schedule;
+    return 0;
+}
+
+// select the decoder of convcode_extrinsic. Returns -1 for an unknown one
+int convcode_set_decoder(t_convcode *code, t_siso_decoder decoder)
+{
+    if (decoder < SISO_LOG_MAP || decoder > SISO_SOVA)
+        return -1;
+
+    code->decoder = decoder;
+    return 0;
+}
+
+// reliability update window of the SOVA, in trellis steps. Returns -1 if it
+// is not positive
+int convcode_set_sova_window(t_convcode *code, int window)
+{
+    if (window <= 0)
+        return -1;
+
+    code->sova_window = window;
+    return 0;
+}
+
+// channel metric of every output pattern of a step
+static void pattern_metrics(double *metrics, double *rho, int components, double scale)
+{
+    for (int p = 0; p < (1 << components); p++) {/*{{{*/
+        double g = 0;
+        for (int j = 0; j < components; j++)
+            g += pow(rho[j] - (2*get_bit(p, j) - 1), 2);
+        metrics[p] = scale * g;
+    }/*}}}*/
+}
+
 void convcode_clear(t_convcode *code)
 {
     for (int i = 0; i < code->components; i++) {/*{{{*/
@@ -166,14 +291,29 @@ void convcode_clear(t_convcode *code)
     free(code->forward_connections);
     free(code->backward_connections);
     free(code->next_state);
-    free(code->neighbors);/*}}}*/
+    free(code->neighbors);
+    free(code->branches_to);
+    free(code->branches_from);/*}}}*/
 }
 
 int* convcode_encode(int *packet, int packet_length, t_convcode *code)
 {
-    // add support for puncturing patterns?/*{{{*/
-    int encoded_length = (packet_length + code->memory) * code->components;
+    // add support for puncturing patterns?
+    int encoded_length = (packet_length + code->memory) * code->components;/*{{{*/
     int *encoded_packet = malloc(encoded_length * sizeof *encoded_packet);
+    convcode_encode_into(encoded_packet, packet, packet_length, code);
+
+    return encoded_packet;/*}}}*/
+}
+
+// same as convcode_encode, into a caller buffer of (packet_length + memory) *
+// components bits
+void convcode_encode_into(int *encoded_packet, int *packet, int packet_length, t_convcode *code)
+{
+    if (code->kernels) {/*{{{*/
+        code->kernels->encode(encoded_packet, packet, packet_length);
+        return;
+    }
 
     int state = 0;
 
@@ -205,15 +345,82 @@ int* convcode_encode(int *packet, int packet_length, t_convcode *code)
         for (int c = 0; c < code->components; c++)
             encoded_packet[code->components * i + c] = output[c];
 
+    }/*}}}*/
+}
+
+// Viterbi on the radix-4 trellis: one survivor per two trellis steps
+static int *convcode_decode_radix4(double *received, int length, t_convcode *code)
+{
+    int N_states = 2 << (code->memory - 1);/*{{{*/
+    int packet_length = length / code->components - code->memory;
+    int steps = (packet_length + code->memory) / 2;
+    int patterns = 1 << code->components;
+    int *decoded_packet = malloc(packet_length * sizeof *decoded_packet);
+
+    double *metric = malloc(N_states * sizeof *metric);
+    double *tmp_metric = malloc(N_states * sizeof *tmp_metric);
+    double *costs = malloc(2 * patterns * sizeof *costs);
+    unsigned char *survivors = malloc(steps * N_states * sizeof *survivors);
+
+    // trellis starts at state 0
+    for (int s = 0; s < N_states; s++)
+        metric[s] = 1e6;
+    metric[0] = 0;
+
+    for (int t = 0; t < steps; t++) {
+        pattern_metrics(costs, &received[2*t*code->components], code->components, 1);
+        pattern_metrics(costs + patterns, &received[(2*t + 1)*code->components], code->components, 1);
+
+        for (int s = 0; s < N_states; s++) {
+            t_branch4 *branch = &code->branches_to[4*s];
+            double minimum_cost = 0;
+            int best = -1;
+            for (int n = 0; n < 4; n++) {
+                double cost = metric[branch[n].from] + costs[branch[n].first] + costs[patterns + branch[n].second];
+                if (best < 0 || cost <= minimum_cost) {
+                    minimum_cost = cost;
+                    best = n;
+                }
+            }
+
+            tmp_metric[s] = minimum_cost;
+            survivors[t*N_states + s] = (unsigned char) best;
+        }
+
+        // normalize
+        double min_metric = tmp_metric[0];
+        for (int s = 0; s < N_states; s++)
+            min_metric = (min_metric < tmp_metric[s]) ? min_metric : tmp_metric[s];
+
+        for (int s = 0; s < N_states; s++)
+            metric[s] = tmp_metric[s] - min_metric;
     }
 
-    return encoded_packet;/*}}}*/
+    // backtrack, the trellis is terminated
+    int state = 0;
+    for (int t = steps - 1; t >= 0; t--) {
+        t_branch4 *branch = &code->branches_to[4*state + survivors[t*N_states + state]];
+        if (2*t < packet_length)
+            decoded_packet[2*t] = branch->u0;
+        if (2*t + 1 < packet_length)
+            decoded_packet[2*t + 1] = branch->u1;
+        state = branch->from;
+    }
+
+    free(metric);
+    free(tmp_metric);
+    free(costs);
+    free(survivors);
+
+    return decoded_packet;/*}}}*/
 }
 
-int* convcode_decode(double *received, int length, t_convcode *code)
+// generic radix-2 Viterbi, compiled for each instruction set level
+static ISA_BODY int *viterbi_radix2_body(double *received, int length, t_convcode *code)
 {
     int N_states = 2 << (code->memory - 1);/*{{{*/
     int packet_length = length / code->components - code->memory;
+
     int *decoded_packet = malloc(packet_length * sizeof *decoded_packet);
 
     // allocate matrix containing survivor sequences and metric vector
@@ -300,6 +507,149 @@ int* convcode_decode(double *received, int length, t_convcode *code)
     return decoded_packet;/*}}}*/
 }
 
+ISA_DISPATCH(static, int *, viterbi_radix2, (double *received, int length, t_convcode *code), (received, length, code))
+
+int* convcode_decode(double *received, int length, t_convcode *code)
+{
+    int N_states = 2 << (code->memory - 1);/*{{{*/
+    int packet_length = length / code->components - code->memory;
+
+    // an odd number of steps can't be merged in pairs
+    if (code->radix == 4 && !((packet_length + code->memory) % 2)) {
+        PERF_KERNEL_BEGIN(PERF_KERNEL_CONVCODE_DECODE);
+        int *decoded = convcode_decode_radix4(received, length, code);
+        PERF_KERNEL_END(PERF_KERNEL_CONVCODE_DECODE, 2.0 * N_states * (packet_length + code->memory), packet_length);
+        return decoded;
+    }
+
+    if (code->kernels) {
+        PERF_KERNEL_BEGIN(PERF_KERNEL_CONVCODE_DECODE);
+        int *decoded = code->kernels->decode(received, length);
+        PERF_KERNEL_END(PERF_KERNEL_CONVCODE_DECODE, 2.0 * N_states * (packet_length + code->memory), packet_length);
+        return decoded;
+    }
+
+    PERF_KERNEL_BEGIN(PERF_KERNEL_CONVCODE_DECODE);
+    int *decoded_packet = viterbi_radix2(received, length, code);
+    PERF_KERNEL_END(PERF_KERNEL_CONVCODE_DECODE, 2.0 * N_states * (packet_length + code->memory), packet_length);
+
+    return decoded_packet;/*}}}*/
+}
+
+// radix-2 Viterbi on up to CONVCODE_BATCH_LANES frames at once. Metrics are
+// interleaved by lane, metric[s*CONVCODE_BATCH_LANES + f], so every state is a
+// vector operation across the frames. Decisions of all the lanes are packed in
+// a byte per state and step. The arithmetic of each lane is the one of
+// convcode_decode, so decisions are identical
+static ISA_BODY void viterbi_batch_body(double **received, int **decoded, int lanes, int length, t_convcode *code)
+{
+    int N_states = 2 << (code->memory - 1);/*{{{*/
+    int C = code->components;
+    int packet_length = length / C - code->memory;
+    int steps = packet_length + code->memory;
+    int patterns = 1 << C;
+    enum {L = CONVCODE_BATCH_LANES};
+
+    // output pattern of every branch, see t_branch4
+    int pattern[2 * N_states];
+    for (int s = 0; s < N_states; s++)
+        for (int u = 0; u < 2; u++)
+            pattern[2*s + u] = code->branches_from[4*s + 2*u].first;
+
+    unsigned char *decisions = malloc(steps * N_states * sizeof *decisions);
+    double metric[N_states][L], tmp_metric[N_states][L];
+    double cost[patterns][L];
+    double rho[C][L];
+
+    for (int s = 0; s < N_states; s++)
+        for (int f = 0; f < L; f++)
+            metric[s][f] = s ? 1e6 : 0;
+
+    for (int i = 0; i < steps; i++) {
+        // unused lanes repeat the first frame
+        for (int c = 0; c < C; c++)
+            for (int f = 0; f < L; f++)
+                rho[c][f] = received[f < lanes ? f : 0][C*i + c];
+
+        // summed over the components in the same order as convcode_decode
+        for (int p = 0; p < patterns; p++) {
+            for (int f = 0; f < L; f++)
+                cost[p][f] = 0;
+            for (int c = 0; c < C; c++) {
+                double bit = (p >> c) & 1;
+                for (int f = 0; f < L; f++) {
+                    double d = rho[c][f] - 2*bit + 1;
+                    cost[p][f] += d*d;
+                }
+            }
+        }
+
+        for (int s = 0; s < N_states; s++) {
+            int nA = abs(code->neighbors[s][0]) - 1;
+            int uA = code->neighbors[s][0] > 0;
+            int nB = abs(code->neighbors[s][1]) - 1;
+            int uB = code->neighbors[s][1] > 0;
+            double *costA = cost[pattern[2*nA + uA]];
+            double *costB = cost[pattern[2*nB + uB]];
+
+            unsigned char choice[L];
+            for (int f = 0; f < L; f++) {
+                double a = costA[f] + metric[nA][f];
+                double b = costB[f] + metric[nB][f];
+                double m = a > b ? b : a;
+                tmp_metric[s][f] = m;
+                choice[f] = m == b;
+            }
+
+            unsigned char packed = 0;
+            for (int f = 0; f < L; f++)
+                packed |= (unsigned char) (choice[f] << f);
+            decisions[i*N_states + s] = packed;
+        }
+
+        double min[L];
+        for (int f = 0; f < L; f++)
+            min[f] = tmp_metric[0][f];
+        for (int s = 0; s < N_states; s++)
+            for (int f = 0; f < L; f++)
+                min[f] = min[f] < tmp_metric[s][f] ? min[f] : tmp_metric[s][f];
+        for (int s = 0; s < N_states; s++)
+            for (int f = 0; f < L; f++)
+                metric[s][f] = tmp_metric[s][f] - min[f];
+    }
+
+    // backtrack every frame from the terminating state
+    for (int f = 0; f < lanes; f++) {
+        int state = 0;
+        for (int i = steps - 1; i >= 0; i--) {
+            int neighbor = code->neighbors[state][(decisions[i*N_states + state] >> f) & 1];
+            if (i < packet_length)
+                decoded[f][i] = neighbor > 0;
+            state = abs(neighbor) - 1;
+        }
+    }
+
+    free(decisions);/*}}}*/
+}
+
+ISA_DISPATCH_VOID(static, viterbi_batch, (double **received, int **decoded, int lanes, int length, t_convcode *code),
+                  (received, decoded, lanes, length, code))
+
+int **convcode_decode_batch(double **received, int frames, int length, t_convcode *code)
+{
+    int packet_length = length / code->components - code->memory;/*{{{*/
+    int **decoded = malloc(frames * sizeof *decoded);
+    for (int f = 0; f < frames; f++)
+        decoded[f] = malloc(packet_length * sizeof *decoded[f]);
+
+    for (int f = 0; f < frames; f += CONVCODE_BATCH_LANES) {
+        int lanes = frames - f < CONVCODE_BATCH_LANES ? frames - f : CONVCODE_BATCH_LANES;
+        viterbi_batch(&received[f], &decoded[f], lanes, length, code);
+    }
+
+    return decoded;/*}}}*/
+}
+
 void print_neighbors(t_convcode *code)
 {
     int N_states = 2 << (code->memory - 1);/*{{{*/
@@ -339,11 +689,630 @@ void print_neighbors(t_convcode *code)
     printf("\n");/*}}}*/
 }
 
-int *convcode_extrinsic(double *received, double length, double ***a_priori, t_convcode *code, double noise_variance,
-                        int decision)
+// BCJR on the radix-4 trellis: forward and backward messages are only kept
+// every other step, and each two-step branch yields the extrinsic messages of
+// both its bits. The first bit excludes its own a priori but includes the
+// one of the second bit, and vice versa
+static int *convcode_extrinsic_radix4(double *received, int length, double ***a_priori, t_convcode *code,
+                                      double noise_variance, int decision)
 {
     int N_states = 2 << (code->memory - 1);/*{{{*/
-    int packet_length = (int) length / code->components - code->memory;
+    int packet_length = length / code->components - code->memory;
+    int total_length = packet_length + code->memory;
+    int steps = total_length / 2;
+    int patterns = 1 << code->components;
+    double threshold = 1e10;
+    double scale = -1/(2*noise_variance);
+
+    // copy a priori probabilities on local array
+    double *app[2];
+    for (int u = 0; u < 2; u++) {
+        app[u] = malloc(total_length * sizeof *app[u]);
+        for (int i = 0; i < total_length; i++)
+            app[u][i] = i < packet_length ? (*a_priori)[u][i] : log(0.5);
+    }
+
+    // metrics of the output patterns of both steps of every branch
+    double *gamma = malloc(2 * steps * patterns * sizeof *gamma);
+    for (int i = 0; i < total_length; i++)
+        pattern_metrics(&gamma[i*patterns], &received[i*code->components], code->components, scale);
+
+    // backward[t] is the message at time 2t + 2, forward[t] at time 2t
+    PROFILE_BEGIN(PROFILE_BCJR_BACKWARD);
+    double *backward = malloc(steps * N_states * sizeof *backward);/*{{{*/
+    for (int s = 0; s < N_states; s++)
+        backward[(steps - 1)*N_states + s] = -threshold;
+    backward[(steps - 1)*N_states] = 0;
+
+    for (int t = steps - 1; t > 0; t--) {
+        double *g0 = &gamma[2*t*patterns];
+        double *g1 = g0 + patterns;
+        double *next = &backward[t*N_states];
+        double *current = &backward[(t - 1)*N_states];
+
+        for (int s = 0; s < N_states; s++) {
+            t_branch4 *branch = &code->branches_from[4*s];
+            double B = -threshold;
+            for (int q = 0; q < 4; q++)
+                B = exp_sum(B, app[branch[q].u0][2*t] + app[branch[q].u1][2*t + 1] + g0[branch[q].first] +
+                               g1[branch[q].second] + next[branch[q].to]);
+            current[s] = B;
+        }
+
+        // normalize
+        double max = current[0];
+        for (int s = 0; s < N_states; s++)
+            max = current[s] > max ? current[s] : max;
+
+        for (int s = 0; s < N_states; s++)
+            current[s] -= max;
+    }/*}}}*/
+    PROFILE_END(PROFILE_BCJR_BACKWARD);
+
+    PROFILE_BEGIN(PROFILE_BCJR_FORWARD);
+    double *forward = malloc(steps * N_states * sizeof *forward);/*{{{*/
+    for (int s = 0; s < N_states; s++)
+        forward[s] = -threshold;
+    forward[0] = 0;
+
+    for (int t = 1; t < steps; t++) {
+        double *g0 = &gamma[2*(t - 1)*patterns];
+        double *g1 = g0 + patterns;
+        double *previous = &forward[(t - 1)*N_states];
+        double *current = &forward[t*N_states];
+
+        for (int s = 0; s < N_states; s++) {
+            t_branch4 *branch = &code->branches_to[4*s];
+            double F = -threshold;
+            for (int n = 0; n < 4; n++)
+                F = exp_sum(F, app[branch[n].u0][2*t - 2] + app[branch[n].u1][2*t - 1] + g0[branch[n].first] +
+                               g1[branch[n].second] + previous[branch[n].from]);
+            current[s] = F;
+        }
+
+        // normalize
+        double max = current[0];
+        for (int s = 0; s < N_states; s++)
+            max = current[s] > max ? current[s] : max;
+
+        for (int s = 0; s < N_states; s++)
+            current[s] -= max;
+    }/*}}}*/
+    PROFILE_END(PROFILE_BCJR_FORWARD);
+
+    PROFILE_BEGIN(PROFILE_BCJR_EXTRINSIC);
+    double *extrinsic[2];/*{{{*/
+    extrinsic[0] = malloc(total_length * sizeof *extrinsic[0]);
+    extrinsic[1] = malloc(total_length * sizeof *extrinsic[1]);
+
+    for (int t = 0; t < steps; t++) {
+        double *g0 = &gamma[2*t*patterns];
+        double *g1 = g0 + patterns;
+        double E[2][2] = {{-threshold, -threshold}, {-threshold, -threshold}};
+
+        for (int q = 0; q < 4*N_states; q++) {
+            t_branch4 *branch = &code->branches_from[q];
+            double path = forward[t*N_states + branch->from] + g0[branch->first] + g1[branch->second] +
+                          backward[t*N_states + branch->to];
+            E[0][branch->u0] = exp_sum(E[0][branch->u0], path + app[branch->u1][2*t + 1]);
+            E[1][branch->u1] = exp_sum(E[1][branch->u1], path + app[branch->u0][2*t]);
+        }
+
+        for (int b = 0; b < 2; b++) {
+            int i = 2*t + b;
+            extrinsic[0][i] = E[b][0];
+            extrinsic[1][i] = E[b][1];
+            if (i < packet_length) {
+                (*a_priori)[0][i] = E[b][0];
+                (*a_priori)[1][i] = E[b][1];
+            }
+        }
+    }/*}}}*/
+    PROFILE_END(PROFILE_BCJR_EXTRINSIC);
+
+    // decision
+    int *decoded = NULL;
+    if (decision){
+        decoded = malloc(packet_length * sizeof *decoded);
+        for (int i = 0; i < packet_length; ++i)
+            decoded[i] = app[1][i] + extrinsic[1][i] > app[0][i] + extrinsic[0][i];
+    }
+
+    for (int u = 0; u < 2; u++) {
+        free(app[u]);
+        free(extrinsic[u]);
+    }
+    free(gamma);
+    free(forward);
+    free(backward);
+
+    return decoded;/*}}}*/
+}
+
+// state of the meet in the middle schedule: forward messages of the first
+// half, backward messages of the second half, and the outputs
+typedef struct str_bcjrmiddle{
+    t_convcode *code;
+    int N_states;
+    int packet_length;
+    int total_length;
+    int half;
+    double *received;
+    double *app[2];
+    double noise_variance;
+    double *forward;        // times 0, ..., half - 1
+    double *backward;       // times half, ..., total_length - 1
+    double *rolling[2];     // last two messages of each recursion past the middle
+    double **a_priori;
+    int *decoded;
+} t_bcjrmiddle;
+
+static void middle_normalize(double *messages, int N_states)
+{
+    double max = messages[0];/*{{{*/
+    for (int s = 0; s < N_states; ++s)
+        max = messages[s] > max ? messages[s] : max;
+
+    for (int s = 0; s < N_states; ++s)
+        messages[s] -= max;/*}}}*/
+}
+
+// same expression as the sequential schedule, for identical results
+static double middle_gamma(double *rho, int *out, int components, double noise_variance)
+{
+    double g = 0;/*{{{*/
+    for (int j = 0; j < components; ++j)
+        g += pow(rho[j] - (2*out[j] - 1), 2);
+    return -g/(2*noise_variance);/*}}}*/
+}
+
+// forward messages at time i from the ones at time i - 1
+static void middle_forward(t_bcjrmiddle *m, int i, double *previous, double *current)
+{
+    t_convcode *code = m->code;/*{{{*/
+    double *rho = &m->received[code->components*(i-1)];
+    for (int s = 0; s < m->N_states; ++s) {
+        double F = -1e10;
+        int *neigh = code->neighbors[s];
+        for (int n = 0; n < 2; ++n) {
+            int state = abs(neigh[n]) - 1;
+            int input = neigh[n] > 0;
+            F = exp_sum(F, m->app[input][i-1] + previous[state] +
+                           middle_gamma(rho, code->output[state][input], code->components, m->noise_variance));
+        }
+        current[s] = F;
+    }
+    middle_normalize(current, m->N_states);/*}}}*/
+}
+
+// backward messages at time i from the ones at time i + 1
+static void middle_backward(t_bcjrmiddle *m, int i, double *next, double *current)
+{
+    t_convcode *code = m->code;/*{{{*/
+    double *rho = &m->received[code->components*(i+1)];
+    for (int s = 0; s < m->N_states; ++s) {
+        double B = -1e10;
+        for (int u = 0; u < 2; ++u)
+            B = exp_sum(B, m->app[u][i+1] + next[code->next_state[s][u]] +
+                           middle_gamma(rho, code->output[s][u], code->components, m->noise_variance));
+        current[s] = B;
+    }
+    middle_normalize(current, m->N_states);/*}}}*/
+}
+
+// extrinsic messages and decision of step i, as soon as both messages exist
+static void middle_extrinsic(t_bcjrmiddle *m, int i, double *forward, double *backward)
+{
+    t_convcode *code = m->code;/*{{{*/
+    if (i >= m->packet_length)
+        return;
+
+    double *rho = &m->received[code->components*i];
+    double E[2];
+    for (int u = 0; u < 2; ++u) {
+        E[u] = -1e10;
+        for (int s = 0; s < m->N_states; ++s)
+            E[u] = exp_sum(E[u], forward[s] + backward[code->next_state[s][u]] +
+                                 middle_gamma(rho, code->output[s][u], code->components, m->noise_variance));
+    }
+
+    if (m->decoded)
+        m->decoded[i] = m->app[1][i] + E[1] > m->app[0][i] + E[0];
+    m->a_priori[0][i] = E[0];
+    m->a_priori[1][i] = E[1];/*}}}*/
+}
+
+// steps of a recursion (role 0 forward, 1 backward) in each phase: up to
+// the middle, then across it
+static int middle_steps(t_bcjrmiddle *m, int role, int phase)
+{
+    if (!phase)
+        return role ? m->total_length - 1 - m->half : m->half - 1;
+    return role ? m->half : m->total_length - m->half;
+}
+
+// step k of a recursion. In the first phase the messages are stored, in the
+// second they meet the stored messages of the other recursion and are only
+// kept in the rolling buffers of the role
+static void middle_step(t_bcjrmiddle *m, int role, int phase, int k)
+{
+    int N = m->N_states;/*{{{*/
+    double *previous = &m->rolling[role][(k % 2)*N];
+    double *current = &m->rolling[role][((k + 1) % 2)*N];
+
+    if (!phase && !role) {
+        int i = k + 1;
+        middle_forward(m, i, &m->forward[(i-1)*N], &m->forward[i*N]);
+    } else if (!phase) {
+        int i = m->total_length - 2 - k;
+        middle_backward(m, i, &m->backward[(i + 1 - m->half)*N], &m->backward[(i - m->half)*N]);
+    } else if (!role) {
+        int i = m->half + k;
+        middle_forward(m, i, k ? previous : &m->forward[(m->half - 1)*N], current);
+        middle_extrinsic(m, i, current, &m->backward[(i - m->half)*N]);
+    } else {
+        int i = m->half - 1 - k;
+        middle_backward(m, i, k ? previous : m->backward, current);
+        middle_extrinsic(m, i, &m->forward[i*N], current);
+    }/*}}}*/
+}
+
+// BCJR with the meet in the middle schedule: the forward recursion runs from
+// the start of the frame and the backward one from its end. Each stores
+// its messages up to the middle, then they cross and emit the extrinsic
+// messages step by step, so only half of the forward and half of the backward
+// messages are ever stored. The two recursions run on two threads with
+// BCJR_MIDDLE_THREADS, when nested parallelism allows it, and alternate on the
+// calling thread otherwise. Same results as the sequential schedule
+static int *convcode_extrinsic_middle(double *received, int length, double ***a_priori, t_convcode *code,
+                                      double noise_variance, int decision)
+{
+    t_bcjrmiddle m;/*{{{*/
+    m.code = code;
+    m.N_states = 2 << (code->memory - 1);
+    m.packet_length = length / code->components - code->memory;
+    m.total_length = m.packet_length + code->memory;
+    m.half = m.total_length / 2;
+    m.received = received;
+    m.noise_variance = noise_variance;
+    m.a_priori = *a_priori;
+    m.decoded = decision ? malloc(m.packet_length * sizeof *m.decoded) : NULL;
+
+    // the a priori messages are overwritten by the extrinsic ones while the
+    // recursions still need them
+    for (int u = 0; u < 2; u++) {
+        m.app[u] = malloc(m.total_length * sizeof *m.app[u]);
+        for (int i = 0; i < m.total_length; i++)
+            m.app[u][i] = i < m.packet_length ? (*a_priori)[u][i] : log(0.5);
+    }
+
+    int N = m.N_states;
+    m.forward = malloc(m.half * N * sizeof *m.forward);
+    m.backward = malloc((m.total_length - m.half) * N * sizeof *m.backward);
+    m.rolling[0] = malloc(2 * N * sizeof *m.rolling[0]);
+    m.rolling[1] = malloc(2 * N * sizeof *m.rolling[1]);
+
+    // both recursions start from the known states at the ends of the frame
+    for (int s = 0; s < N; s++) {
+        m.forward[s] = -1e10;
+        m.backward[(m.total_length - 1 - m.half)*N + s] = -1e10;
+    }
+    m.forward[0] = 0;
+    m.backward[(m.total_length - 1 - m.half)*N] = 0;
+
+    if (code->schedule == BCJR_MIDDLE_THREADS) {
+        #pragma omp parallel num_threads(2)
+        {
+            int threads = omp_get_num_threads();
+            for (int phase = 0; phase < 2; phase++) {
+                for (int role = omp_get_thread_num(); role < 2; role += threads)
+                    for (int k = 0; k < middle_steps(&m, role, phase); k++)
+                        middle_step(&m, role, phase, k);
+
+                // the second phase reads the messages stored by the other role
+                #pragma omp barrier
+            }
+        }
+    } else {
+        // the two recursions are independent: alternating their steps
+        // leaves room for instruction-level parallelism
+        for (int phase = 0; phase < 2; phase++) {
+            int steps = middle_steps(&m, 0, phase) > middle_steps(&m, 1, phase) ? middle_steps(&m, 0, phase) :
+                        middle_steps(&m, 1, phase);
+            for (int k = 0; k < steps; k++)
+                for (int role = 0; role < 2; role++)
+                    if (k < middle_steps(&m, role, phase))
+                        middle_step(&m, role, phase, k);
+        }
+    }
+
+    free(m.app[0]);
+    free(m.app[1]);
+    free(m.forward);
+    free(m.backward);
+    free(m.rolling[0]);
+    free(m.rolling[1]);
+
+    return m.decoded;/*}}}*/
+}
+
+// reliability of bits whose competitors all agree with the survivor within
+// the window: large, but far from the floors of the log-domain decoders
+#define SOVA_MAX_RELIABILITY 1e3
+
+// SOVA reliabilities are overoptimistic: scaling the extrinsic messages
+// recovers part of the gap to the BCJR (0.5 measured best on the CCSDS codes)
+#define SOVA_EXTRINSIC_SCALE 0.5
+
+// soft-output Viterbi: the add-compare-select of convcode_decode on
+// log-likelihood metrics including the a priori messages, keeping the metric
+// difference of every decision. After the traceback, the competitor of each
+// step of the survivor is followed back for at most sova_window steps, and
+// bits where it disagrees get a reliability no larger than that difference.
+// Extrinsic messages are the soft outputs minus the a priori ratios, scaled
+static ISA_BODY int *sova_body(double *received, int length, double ***a_priori, t_convcode *code,
+                               double noise_variance, int decision)
+{
+    int N_states = 2 << (code->memory - 1);/*{{{*/
+    int C = code->components;
+    int packet_length = length / C - code->memory;
+    int steps = packet_length + code->memory;
+    int patterns = 1 << C;
+
+    // output pattern of every branch, see t_branch4
+    int *pattern = malloc(2 * N_states * sizeof *pattern);
+    for (int s = 0; s < N_states; s++)
+        for (int u = 0; u < 2; u++)
+            pattern[2*s + u] = code->branches_from[4*s + 2*u].first;
+
+    unsigned char *survivors = malloc(steps * N_states);
+    unsigned char *bits = malloc(steps * sizeof *bits);
+    float *differences = malloc(steps * N_states * sizeof *differences);
+    double *metric = malloc(N_states * sizeof *metric);
+    double *tmp_metric = malloc(N_states * sizeof *tmp_metric);
+    double gamma[patterns];
+
+    for (int s = 0; s < N_states; s++)
+        metric[s] = -1e10;
+    metric[0] = 0;
+
+    // add-compare-select, maximizing
+    PROFILE_BEGIN(PROFILE_BCJR_FORWARD);
+    for (int i = 0; i < steps; i++) {/*{{{*/
+        pattern_metrics(gamma, &received[C*i], C, -1/(2*noise_variance));
+        double a[2];
+        a[0] = i < packet_length ? (*a_priori)[0][i] : 0;
+        a[1] = i < packet_length ? (*a_priori)[1][i] : 0;
+
+        double max = -1e10;
+        for (int s = 0; s < N_states; s++) {
+            int nA = abs(code->neighbors[s][0]) - 1;
+            int uA = code->neighbors[s][0] > 0;
+            int nB = abs(code->neighbors[s][1]) - 1;
+            int uB = code->neighbors[s][1] > 0;
+
+            double mA = metric[nA] + a[uA] + gamma[pattern[2*nA + uA]];
+            double mB = metric[nB] + a[uB] + gamma[pattern[2*nB + uB]];
+
+            survivors[i*N_states + s] = mB > mA;
+            differences[i*N_states + s] = (float) fabs(mA - mB);
+            tmp_metric[s] = mB > mA ? mB : mA;
+            max = tmp_metric[s] > max ? tmp_metric[s] : max;
+        }
+
+        for (int s = 0; s < N_states; s++)
+            metric[s] = tmp_metric[s] - max;
+    }/*}}}*/
+    PROFILE_END(PROFILE_BCJR_FORWARD);
+
+    // survivor of the terminated trellis: path[i] is the state after step i
+    PROFILE_BEGIN(PROFILE_BCJR_BACKWARD);
+    int *path = malloc((steps + 1) * sizeof *path);/*{{{*/
+    path[steps] = 0;
+    for (int i = steps - 1; i >= 0; i--) {
+        int neighbor = code->neighbors[path[i+1]][survivors[i*N_states + path[i+1]]];
+        bits[i] = neighbor > 0;
+        path[i] = abs(neighbor) - 1;
+    }/*}}}*/
+    PROFILE_END(PROFILE_BCJR_BACKWARD);
+
+    // reliability updates along the competitors
+    PROFILE_BEGIN(PROFILE_BCJR_EXTRINSIC);
+    double *reliability = malloc(steps * sizeof *reliability);/*{{{*/
+    for (int i = 0; i < steps; i++)
+        reliability[i] = SOVA_MAX_RELIABILITY;
+
+    for (int i = 0; i < steps; i++) {
+        int s = path[i+1];
+        double delta = differences[i*N_states + s];
+        int state = s;
+        int choice = !survivors[i*N_states + s];
+
+        for (int j = i; j >= 0 && j > i - code->sova_window; j--) {
+            // the competitor merged into the survivor: same bits from here on
+            if (j < i && state == path[j+1])
+                break;
+
+            int neighbor = code->neighbors[state][choice];
+            if ((neighbor > 0) != bits[j] && delta < reliability[j])
+                reliability[j] = delta;
+
+            state = abs(neighbor) - 1;
+            choice = j > 0 ? survivors[(j-1)*N_states + state] : 0;
+        }
+    }
+
+    int *decoded = decision ? malloc(packet_length * sizeof *decoded) : NULL;
+    for (int i = 0; i < packet_length; i++) {
+        double llr = bits[i] ? reliability[i] : -reliability[i];
+        double extrinsic = SOVA_EXTRINSIC_SCALE*(llr - ((*a_priori)[1][i] - (*a_priori)[0][i]));
+        (*a_priori)[0][i] = -extrinsic/2;
+        (*a_priori)[1][i] = extrinsic/2;
+
+        if (decision)
+            decoded[i] = bits[i];
+    }/*}}}*/
+    PROFILE_END(PROFILE_BCJR_EXTRINSIC);
+
+    free(pattern);
+    free(survivors);
+    free(differences);
+    free(metric);
+    free(tmp_metric);
+    free(path);
+    free(bits);
+    free(reliability);
+
+    return decoded;/*}}}*/
+}
+
+ISA_DISPATCH(static, int *, sova, (double *received, int length, double ***a_priori, t_convcode *code,
+                                   double noise_variance, int decision),
+             (received, length, a_priori, code, noise_variance, decision))
+
+// extrinsic messages below this are clamped: the probability domain can't
+// tell them from zero
+#define PROBABILITY_LOG_FLOOR -700
+
+// BCJR on probabilities: a priori messages and channel metrics are converted
+// once per step, then the recursions only multiply and add. Every step is
+// scaled to sum to one, which does not change the ratios between branches.
+// Extrinsic messages go back to the log domain of convcode_extrinsic
+static ISA_BODY int *bcjr_probability_body(double *received, int length, double ***a_priori, t_convcode *code,
+                                           double noise_variance, int decision)
+{
+    int N_states = 2 << (code->memory - 1);/*{{{*/
+    int C = code->components;
+    int packet_length = length / C - code->memory;
+    int steps = packet_length + code->memory;
+    int patterns = 1 << C;
+
+    // a priori probabilities, scaled so that the larger one is 1
+    double *app[2];
+    app[0] = malloc(steps * sizeof *app[0]);
+    app[1] = malloc(steps * sizeof *app[1]);
+    for (int i = 0; i < steps; i++) {
+        double a0 = i < packet_length ? (*a_priori)[0][i] : 0;
+        double a1 = i < packet_length ? (*a_priori)[1][i] : 0;
+        double max = a0 > a1 ? a0 : a1;
+        app[0][i] = exp(a0 - max);
+        app[1][i] = exp(a1 - max);
+    }
+
+    // output pattern of every branch, see t_branch4
+    int *pattern = malloc(2 * N_states * sizeof *pattern);
+    for (int s = 0; s < N_states; s++)
+        for (int u = 0; u < 2; u++)
+            pattern[2*s + u] = code->branches_from[4*s + 2*u].first;
+
+    // channel likelihoods of every pattern, relative to the most likely one
+    double *gamma = malloc(steps * patterns * sizeof *gamma);
+    for (int i = 0; i < steps; i++) {
+        double *g = &gamma[i*patterns];
+        pattern_metrics(g, &received[C*i], C, -1/(2*noise_variance));
+
+        double max = g[0];
+        for (int p = 0; p < patterns; p++)
+            max = g[p] > max ? g[p] : max;
+        for (int p = 0; p < patterns; p++)
+            g[p] = exp(g[p] - max);
+    }
+
+    // backward messages
+    PROFILE_BEGIN(PROFILE_BCJR_BACKWARD);
+    double *backward = calloc(steps * N_states, sizeof *backward);/*{{{*/
+    backward[(steps - 1)*N_states] = 1;
+
+    for (int i = steps - 2; i >= 0; i--) {
+        double *g = &gamma[(i+1)*patterns];
+        double *next = &backward[(i+1)*N_states];
+        double *current = &backward[i*N_states];
+        double a0 = app[0][i+1], a1 = app[1][i+1];
+
+        double sum = 0;
+        for (int s = 0; s < N_states; s++) {
+            current[s] = a0*next[code->next_state[s][0]]*g[pattern[2*s]] +
+                         a1*next[code->next_state[s][1]]*g[pattern[2*s + 1]];
+            sum += current[s];
+        }
+
+        for (int s = 0; s < N_states; s++)
+            current[s] /= sum;
+    }/*}}}*/
+    PROFILE_END(PROFILE_BCJR_BACKWARD);
+
+    // forward messages
+    PROFILE_BEGIN(PROFILE_BCJR_FORWARD);
+    double *forward = calloc(steps * N_states, sizeof *forward);/*{{{*/
+    forward[0] = 1;
+
+    for (int i = 1; i < steps; i++) {
+        double *g = &gamma[(i-1)*patterns];
+        double *previous = &forward[(i-1)*N_states];
+        double *current = &forward[i*N_states];
+
+        double sum = 0;
+        for (int s = 0; s < N_states; s++) {
+            double F = 0;
+            for (int n = 0; n < 2; n++) {
+                int state = abs(code->neighbors[s][n]) - 1;
+                int input = code->neighbors[s][n] > 0;
+                F += app[input][i-1]*previous[state]*g[pattern[2*state + input]];
+            }
+            current[s] = F;
+            sum += F;
+        }
+
+        for (int s = 0; s < N_states; s++)
+            current[s] /= sum;
+    }/*}}}*/
+    PROFILE_END(PROFILE_BCJR_FORWARD);
+
+    // extrinsic messages and decisions
+    PROFILE_BEGIN(PROFILE_BCJR_EXTRINSIC);
+    int *decoded = decision ? malloc(packet_length * sizeof *decoded) : NULL;/*{{{*/
+    for (int i = 0; i < packet_length; i++) {
+        double *g = &gamma[i*patterns];
+        double *f = &forward[i*N_states];
+        double *b = &backward[i*N_states];
+
+        double E[2] = {0, 0};
+        for (int s = 0; s < N_states; s++) {
+            E[0] += f[s]*b[code->next_state[s][0]]*g[pattern[2*s]];
+            E[1] += f[s]*b[code->next_state[s][1]]*g[pattern[2*s + 1]];
+        }
+
+        double max = E[0] > E[1] ? E[0] : E[1];
+        for (int u = 0; u < 2; u++) {
+            double e = log(E[u]/max);
+            (*a_priori)[u][i] = e > PROBABILITY_LOG_FLOOR ? e : PROBABILITY_LOG_FLOOR;
+        }
+
+        if (decision)
+            decoded[i] = app[1][i]*E[1] > app[0][i]*E[0];
+    }/*}}}*/
+    PROFILE_END(PROFILE_BCJR_EXTRINSIC);
+
+    free(app[0]);
+    free(app[1]);
+    free(pattern);
+    free(gamma);
+    free(backward);
+    free(forward);
+
+    return decoded;/*}}}*/
+}
+
+ISA_DISPATCH(static, int *, bcjr_probability, (double *received, int length, double ***a_priori, t_convcode *code,
+                                               double noise_variance, int decision),
+             (received, length, a_priori, code, noise_variance, decision))
+
+// generic sequential radix-2 BCJR, compiled for each instruction set level
+static ISA_BODY int *bcjr_radix2_body(double *received, int length, double ***a_priori, t_convcode *code,
+                                      double noise_variance, int decision)
+{
+    int N_states = 2 << (code->memory - 1);/*{{{*/
+    int packet_length = length / code->components - code->memory;
 
     long int threshold = 1e10;
     // copy a priori probabilities on local array
@@ -365,6 +1334,7 @@ int *convcode_extrinsic(double *received, double length, double ***a_priori, t_c
     /*}}}*/
 
     // initialize backward messages
+    PROFILE_BEGIN(PROFILE_BCJR_BACKWARD);
     double **backward = malloc(N_states * sizeof(double*));/*{{{*/
     for (int k = 0; k < N_states; ++k) {
         backward[k] = malloc((packet_length + code->memory) * sizeof(double));
@@ -405,8 +1375,10 @@ int *convcode_extrinsic(double *received, double length, double ***a_priori, t_c
         for (int s = 0; s < N_states; ++s)
             backward[s][i] -= max;
     }/*}}}*/
+    PROFILE_END(PROFILE_BCJR_BACKWARD);
 
     // initialize forward messages
+    PROFILE_BEGIN(PROFILE_BCJR_FORWARD);
     double **forward = malloc(N_states * sizeof(double*));/*{{{*/
     for (int k = 0; k < N_states; ++k) {
         forward[k] = malloc((packet_length + code->memory) * sizeof(double));
@@ -452,8 +1424,10 @@ int *convcode_extrinsic(double *received, double length, double ***a_priori, t_c
         for (int s = 0; s < N_states; ++s)
             forward[s][i] -= max;
     }/*}}}*/
+    PROFILE_END(PROFILE_BCJR_FORWARD);
 
     // initialize extrinsic messages
+    PROFILE_BEGIN(PROFILE_BCJR_EXTRINSIC);
     double **extrinsic = malloc(2 * sizeof(double*));/*{{{*/
 
     for (int k = 0; k < 2; ++k) {
@@ -494,6 +1468,7 @@ int *convcode_extrinsic(double *received, double length, double ***a_priori, t_c
             (*a_priori)[1][i] = extrinsic[1][i];
         }
     }/*}}}*/
+    PROFILE_END(PROFILE_BCJR_EXTRINSIC);
 
     // decision
     int *decoded = NULL;
@@ -522,14 +1497,230 @@ int *convcode_extrinsic(double *received, double length, double ***a_priori, t_c
     free(app);
     free(rho);/*}}}*/
 
-    return decoded;
+    return decoded;/*}}}*/
+}
 
-    /*}}}*/
+ISA_DISPATCH(static, int *, bcjr_radix2, (double *received, int length, double ***a_priori, t_convcode *code,
+                                          double noise_variance, int decision),
+             (received, length, a_priori, code, noise_variance, decision))
+
+int *convcode_extrinsic(double *received, double length, double ***a_priori, t_convcode *code, double noise_variance,
+                        int decision)
+{
+    int N_states = 2 << (code->memory - 1);/*{{{*/
+    int packet_length = (int) length / code->components - code->memory;
+
+    if (code->decoder == SISO_SOVA) {
+        PERF_KERNEL_BEGIN(PERF_KERNEL_CONVCODE_EXTRINSIC);
+        int *decoded = sova(received, (int) length, a_priori, code, noise_variance, decision);
+        PERF_KERNEL_END(PERF_KERNEL_CONVCODE_EXTRINSIC, 2.0 * N_states * (packet_length + code->memory),
+                        packet_length);
+        return decoded;
+    }
+
+    // the probability domain decoder is always sequential and radix-2
+    if (code->decoder == SISO_PROBABILITY) {
+        PERF_KERNEL_BEGIN(PERF_KERNEL_CONVCODE_EXTRINSIC);
+        int *decoded = bcjr_probability(received, (int) length, a_priori, code, noise_variance, decision);
+        PERF_KERNEL_END(PERF_KERNEL_CONVCODE_EXTRINSIC, 2.0 * N_states * (packet_length + code->memory),
+                        packet_length);
+        return decoded;
+    }
+
+    // an odd number of steps can't be merged in pairs
+    if (code->radix == 4 && !((packet_length + code->memory) % 2)) {
+        PERF_KERNEL_BEGIN(PERF_KERNEL_CONVCODE_EXTRINSIC);
+        int *decoded = convcode_extrinsic_radix4(received, (int) length, a_priori, code, noise_variance, decision);
+        PERF_KERNEL_END(PERF_KERNEL_CONVCODE_EXTRINSIC, 2.0 * N_states * (packet_length + code->memory),
+                        packet_length);
+        return decoded;
+    }
+
+    if (code->schedule != BCJR_SEQUENTIAL) {
+        PERF_KERNEL_BEGIN(PERF_KERNEL_CONVCODE_EXTRINSIC);
+        int *decoded = convcode_extrinsic_middle(received, (int) length, a_priori, code, noise_variance, decision);
+        PERF_KERNEL_END(PERF_KERNEL_CONVCODE_EXTRINSIC, 2.0 * N_states * (packet_length + code->memory),
+                        packet_length);
+        return decoded;
+    }
+
+    // one kernel, the stages are not profiled separately
+    if (code->kernels) {
+        PERF_KERNEL_BEGIN(PERF_KERNEL_CONVCODE_EXTRINSIC);
+        int *decoded = code->kernels->extrinsic(received, (int) length, *a_priori, noise_variance, decision);
+        PERF_KERNEL_END(PERF_KERNEL_CONVCODE_EXTRINSIC, 2.0 * N_states * (packet_length + code->memory),
+                        packet_length);
+        return decoded;
+    }
+
+    PERF_KERNEL_BEGIN(PERF_KERNEL_CONVCODE_EXTRINSIC);
+    int *decoded = bcjr_radix2(received, (int) length, a_priori, code, noise_variance, decision);
+    PERF_KERNEL_END(PERF_KERNEL_CONVCODE_EXTRINSIC, 2.0 * N_states * (packet_length + code->memory), packet_length);
+
+    return decoded;/*}}}*/
+}
+
+// minus infinity of the single precision BCJR: far below any normalized
+// message, and a sum of three of them is still finite
+#define FLOAT_FLOOR -1e30f
+
+// exp_sum in single precision, where the correction term vanishes past 17
+static float exp_sum_float(float a, float b)
+{
+    float max = a > b ? a : b;/*{{{*/
+    float diff = fabsf(a - b);
+    return diff > 17 ? max : max + log1pf(expf(-diff));/*}}}*/
+}
+
+// sequential radix-2 BCJR on floats. The channel metric of every output
+// pattern is computed once per step, messages are stored one step per row
+static ISA_BODY int *bcjr_float_body(float *received, int length, float ***a_priori, t_convcode *code,
+                                     float noise_variance, int decision)
+{
+    int N_states = 2 << (code->memory - 1);/*{{{*/
+    int C = code->components;
+    int packet_length = length / C - code->memory;
+    int steps = packet_length + code->memory;
+    int patterns = 1 << C;
+    float scale = -1/(2*noise_variance);
+
+    float *app[2];
+    for (int u = 0; u < 2; u++) {
+        app[u] = malloc(steps * sizeof *app[u]);
+        for (int i = 0; i < steps; i++)
+            app[u][i] = i < packet_length ? (*a_priori)[u][i] : logf(0.5f);
+    }
+
+    // output pattern of every branch, see t_branch4
+    int *pattern = malloc(2 * N_states * sizeof *pattern);
+    for (int s = 0; s < N_states; s++)
+        for (int u = 0; u < 2; u++)
+            pattern[2*s + u] = code->branches_from[4*s + 2*u].first;
+
+    float *gamma = malloc(steps * patterns * sizeof *gamma);
+    for (int i = 0; i < steps; i++) {
+        for (int p = 0; p < patterns; p++) {
+            float g = 0;
+            for (int c = 0; c < C; c++) {
+                float d = received[C*i + c] - (2*get_bit(p, c) - 1);
+                g += d*d;
+            }
+            gamma[i*patterns + p] = scale*g;
+        }
+    }
+
+    // backward messages
+    PROFILE_BEGIN(PROFILE_BCJR_BACKWARD);
+    float *backward = malloc(steps * N_states * sizeof *backward);/*{{{*/
+    float *last = &backward[(steps - 1)*N_states];
+    for (int s = 0; s < N_states; s++)
+        last[s] = FLOAT_FLOOR;
+    last[0] = 0;
+
+    for (int i = steps - 2; i >= 0; i--) {
+        float *g = &gamma[(i+1)*patterns];
+        float *next = &backward[(i+1)*N_states];
+        float *current = &backward[i*N_states];
+
+        float max = FLOAT_FLOOR;
+        for (int s = 0; s < N_states; s++) {
+            float B = FLOAT_FLOOR;
+            for (int u = 0; u < 2; u++)
+                B = exp_sum_float(B, app[u][i+1] + next[code->next_state[s][u]] + g[pattern[2*s + u]]);
+            current[s] = B;
+            max = B > max ? B : max;
+        }
+
+        for (int s = 0; s < N_states; s++)
+            current[s] -= max;
+    }/*}}}*/
+    PROFILE_END(PROFILE_BCJR_BACKWARD);
+
+    // forward messages
+    PROFILE_BEGIN(PROFILE_BCJR_FORWARD);
+    float *forward = malloc(steps * N_states * sizeof *forward);/*{{{*/
+    for (int s = 0; s < N_states; s++)
+        forward[s] = FLOAT_FLOOR;
+    forward[0] = 0;
+
+    for (int i = 1; i < steps; i++) {
+        float *g = &gamma[(i-1)*patterns];
+        float *previous = &forward[(i-1)*N_states];
+        float *current = &forward[i*N_states];
+
+        float max = FLOAT_FLOOR;
+        for (int s = 0; s < N_states; s++) {
+            float F = FLOAT_FLOOR;
+            for (int n = 0; n < 2; n++) {
+                int state = abs(code->neighbors[s][n]) - 1;
+                int input = code->neighbors[s][n] > 0;
+                F = exp_sum_float(F, app[input][i-1] + previous[state] + g[pattern[2*state + input]]);
+            }
+            current[s] = F;
+            max = F > max ? F : max;
+        }
+
+        for (int s = 0; s < N_states; s++)
+            current[s] -= max;
+    }/*}}}*/
+    PROFILE_END(PROFILE_BCJR_FORWARD);
+
+    // extrinsic messages and decisions
+    PROFILE_BEGIN(PROFILE_BCJR_EXTRINSIC);
+    int *decoded = decision ? malloc(packet_length * sizeof *decoded) : NULL;/*{{{*/
+    for (int i = 0; i < packet_length; i++) {
+        float *g = &gamma[i*patterns];
+        float *f = &forward[i*N_states];
+        float *b = &backward[i*N_states];
+
+        float E[2];
+        for (int u = 0; u < 2; u++) {
+            E[u] = FLOAT_FLOOR;
+            for (int s = 0; s < N_states; s++)
+                E[u] = exp_sum_float(E[u], f[s] + b[code->next_state[s][u]] + g[pattern[2*s + u]]);
+            (*a_priori)[u][i] = E[u];
+        }
+
+        if (decision)
+            decoded[i] = app[1][i] + E[1] > app[0][i] + E[0];
+    }/*}}}*/
+    PROFILE_END(PROFILE_BCJR_EXTRINSIC);
+
+    free(app[0]);
+    free(app[1]);
+    free(pattern);
+    free(gamma);
+    free(backward);
+    free(forward);
+
+    return decoded;/*}}}*/
+}
+
+ISA_DISPATCH(static, int *, bcjr_float, (float *received, int length, float ***a_priori, t_convcode *code,
+                                         float noise_variance, int decision),
+             (received, length, a_priori, code, noise_variance, decision))
+
+// single precision BCJR: same interface as convcode_extrinsic on floats, always
+// sequential and radix-2
+int *convcode_extrinsic_float(float *received, int length, float ***a_priori, t_convcode *code, float noise_variance,
+                              int decision)
+{
+    int N_states = 2 << (code->memory - 1);/*{{{*/
+    int packet_length = length / code->components - code->memory;
+
+    PERF_KERNEL_BEGIN(PERF_KERNEL_CONVCODE_EXTRINSIC);
+    int *decoded = bcjr_float(received, length, a_priori, code, noise_variance, decision);
+    PERF_KERNEL_END(PERF_KERNEL_CONVCODE_EXTRINSIC, 2.0 * N_states * (packet_length + code->memory), packet_length);
+
+    return decoded;/*}}}*/
 }
 
+// log(exp(a) + exp(b)): the correction term applies whichever is larger,
+// and is below double precision past a difference of 37
 static double exp_sum(double a, double b)
 {
-    double diff = a-b;/*{{{*/
-    return (a > b) ? a : b + log(1 + exp(-diff > 0 ? diff : -diff));/*}}}*//*}}}*/
+    double max = a > b ? a : b;/*{{{*/
+    double diff = fabs(a - b);
+    return diff > 37 ? max : max + log1p(exp(-diff));/*}}}*//*}}}*/
 }
 
@@ -5,6 +5,38 @@
 #ifndef DEEPSPACE_TURBO_LIBCONVCODES_H
 #define DEEPSPACE_TURBO_LIBCONVCODES_H
 
+#include "convkernels.h"
+
+// order of the BCJR recursions: backward, forward then extrinsic over the
+// whole frame, or meeting in the middle on one or two threads
+typedef enum {
+    BCJR_SEQUENTIAL,
+    BCJR_MIDDLE,
+    BCJR_MIDDLE_THREADS
+} t_bcjr_schedule;
+
+// soft-input soft-output decoder behind convcode_extrinsic: BCJR on
+// log-probabilities, BCJR on probabilities scaled at every step, or the
+// soft-output Viterbi algorithm
+typedef enum {
+    SISO_LOG_MAP,
+    SISO_PROBABILITY,
+    SISO_SOVA
+} t_siso_decoder;
+
+// steps a SOVA competitor path is followed back to update reliabilities
+#define SOVA_DEFAULT_WINDOW 64
+
+// two trellis steps merged in one: from --u0--> middle --u1--> to
+typedef struct str_branch4{
+    int from;
+    int to;
+    int u0;
+    int u1;
+    int first;      // output pattern of the first step, bit c is output c
+    int second;     // output pattern of the second step
+} t_branch4;
+
 typedef struct str_convcode{
     int components;
     int memory;
@@ -13,6 +45,18 @@ typedef struct str_convcode{
     int **next_state;
     int **neighbors;
     int ***output;
+
+    // radix-4 trellis, four branches per state: branches_to[4*s + n] end in
+    // s, branches_from[4*s + 2*u0 + u1] start from s
+    int radix;
+    t_bcjr_schedule schedule;
+    t_siso_decoder decoder;
+    int sova_window;
+    t_branch4 *branches_to;
+    t_branch4 *branches_from;
+
+    // kernels generated for this code at build time, NULL if there are none
+    t_convkernels *kernels;
 } t_convcode;
 
 int get_bit(int num, int position);
@@ -22,14 +66,27 @@ int *convcode_output(int state, int input, t_convcode *code);
 
 t_convcode *convcode_initialize(char *forward[], char *backward, int N_components);
 void convcode_clear(t_convcode *code);
+int convcode_set_radix(t_convcode *code, int radix);
+int convcode_set_schedule(t_convcode *code, t_bcjr_schedule schedule);
+int convcode_set_decoder(t_convcode *code, t_siso_decoder decoder);
+int convcode_set_sova_window(t_convcode *code, int window);
+int convcode_use_kernels(t_convcode *code, int use);
 int* convcode_encode(int *packet, int packet_length, t_convcode *code);
+void convcode_encode_into(int *encoded, int *packet, int packet_length, t_convcode *code);
 int* convcode_decode(double *received, int length, t_convcode *code);
 
+// Viterbi decoding of many frames of the same code and length, one frame per
+// lane: returns one decoded packet per frame
+#define CONVCODE_BATCH_LANES 8
+int **convcode_decode_batch(double **received, int frames, int length, t_convcode *code);
+
 void print_neighbors(t_convcode *code);
 
 // BCJR decoding
 int * convcode_extrinsic(double *received, double length, double ***a_priori, t_convcode *code, double noise_variance,
                          int decision);
+int *convcode_extrinsic_float(float *received, int length, float ***a_priori, t_convcode *code, float noise_variance,
+                              int decision);
 
 static double exp_sum(double a, double b);
 
@@ -0,0 +1,277 @@
+#include "libinterleaver.h"
+#include "cpudispatch.h"
+#include <stdlib.h>
+#include <string.h>
+
+// reads are random: the source of element i + PREFETCH_DISTANCE is requested
+// while element i is copied. CCSDS frames (8920 doubles per row) fit in L2,
+// where the hardware keeps up and prefetching measured slightly slower, so it
+// only kicks in for longer permutations
+#define PREFETCH_DISTANCE 16
+#define PREFETCH_MIN_LENGTH 65536
+
+#if defined(__GNUC__)
+#define PREFETCH(address) __builtin_prefetch(address, 0, 3)
+#else
+#define PREFETCH(address)
+#endif
+
+// return NULL if permutation is not a permutation of 0, ..., length - 1
+t_interleaver *interleaver_initialize(int *permutation, int length)
+{
+    int *inverse = malloc(length * sizeof *inverse);/*{{{*/
+    for (int i = 0; i < length; i++)
+        inverse[i] = -1;
+
+    for (int i = 0; i < length; i++) {
+        int j = permutation[i];
+        if (j < 0 || j >= length || inverse[j] >= 0) {
+            free(inverse);
+            return NULL;
+        }
+        inverse[j] = i;
+    }
+
+    t_interleaver *pi = malloc(sizeof *pi);
+    pi->length = length;
+    pi->forward = permutation;
+    pi->inverse = inverse;
+
+    return pi;/*}}}*/
+}
+
+void interleaver_clear(t_interleaver *pi)
+{
+    free(pi->inverse);
+    pi->inverse = NULL;
+}
+
+static ISA_BODY void interleaver_apply_body(t_interleaver *pi, double *out, double *in, int direction)
+{
+    int *table = direction == DEINTERLEAVE ? pi->inverse : pi->forward;/*{{{*/
+    int n = pi->length;
+    int ahead = n >= PREFETCH_MIN_LENGTH ? n - PREFETCH_DISTANCE : 0;
+    int i = 0;
+
+    for (; i < ahead; i++) {
+        PREFETCH(&in[table[i + PREFETCH_DISTANCE]]);
+        out[i] = in[table[i]];
+    }
+
+    for (; i < n; i++)
+        out[i] = in[table[i]];/*}}}*/
+}
+
+ISA_DISPATCH_VOID(, interleaver_apply, (t_interleaver *pi, double *out, double *in, int direction),
+                  (pi, out, in, direction))
+
+static ISA_BODY void interleaver_apply_bits_body(t_interleaver *pi, int *out, int *in, int direction)
+{
+    int *table = direction == DEINTERLEAVE ? pi->inverse : pi->forward;/*{{{*/
+    int n = pi->length;
+    int ahead = n >= PREFETCH_MIN_LENGTH ? n - PREFETCH_DISTANCE : 0;
+    int i = 0;
+
+    for (; i < ahead; i++) {
+        PREFETCH(&in[table[i + PREFETCH_DISTANCE]]);
+        out[i] = in[table[i]];
+    }
+
+    for (; i < n; i++)
+        out[i] = in[table[i]];/*}}}*/
+}
+
+ISA_DISPATCH_VOID(, interleaver_apply_bits, (t_interleaver *pi, int *out, int *in, int direction),
+                  (pi, out, in, direction))
+
+// both rows of the decoder messages in one pass over the table
+static ISA_BODY void interleaver_apply_pair_body(t_interleaver *pi, double *out[2], double *in[2], int direction)
+{
+    int *table = direction == DEINTERLEAVE ? pi->inverse : pi->forward;/*{{{*/
+    int n = pi->length;
+    double *in0 = in[0], *in1 = in[1];
+    double *out0 = out[0], *out1 = out[1];
+    int ahead = n >= PREFETCH_MIN_LENGTH ? n - PREFETCH_DISTANCE : 0;
+    int i = 0;
+
+    for (; i < ahead; i++) {
+        int next = table[i + PREFETCH_DISTANCE];
+        PREFETCH(&in0[next]);
+        PREFETCH(&in1[next]);
+        int j = table[i];
+        out0[i] = in0[j];
+        out1[i] = in1[j];
+    }
+
+    for (; i < n; i++) {
+        int j = table[i];
+        out0[i] = in0[j];
+        out1[i] = in1[j];
+    }/*}}}*/
+}
+
+ISA_DISPATCH_VOID(, interleaver_apply_pair, (t_interleaver *pi, double *out[2], double *in[2], int direction),
+                  (pi, out, in, direction))
+
+// same on the rows of the single precision decoder
+static ISA_BODY void interleaver_apply_pair_float_body(t_interleaver *pi, float *out[2], float *in[2], int direction)
+{
+    int *table = direction == DEINTERLEAVE ? pi->inverse : pi->forward;/*{{{*/
+    int n = pi->length;
+    float *in0 = in[0], *in1 = in[1];
+    float *out0 = out[0], *out1 = out[1];
+    int ahead = n >= PREFETCH_MIN_LENGTH ? n - PREFETCH_DISTANCE : 0;
+    int i = 0;
+
+    for (; i < ahead; i++) {
+        int next = table[i + PREFETCH_DISTANCE];
+        PREFETCH(&in0[next]);
+        PREFETCH(&in1[next]);
+        int j = table[i];
+        out0[i] = in0[j];
+        out1[i] = in1[j];
+    }
+
+    for (; i < n; i++) {
+        int j = table[i];
+        out0[i] = in0[j];
+        out1[i] = in1[j];
+    }/*}}}*/
+}
+
+ISA_DISPATCH_VOID(, interleaver_apply_pair_float, (t_interleaver *pi, float *out[2], float *in[2], int direction),
+                  (pi, out, in, direction))
+
+// the copy is sequential, only the gather is random
+void interleaver_apply_inplace(t_interleaver *pi, double *data, double *scratch, int direction)
+{
+    memcpy(scratch, data, pi->length * sizeof *scratch);
+    interleaver_apply(pi, data, scratch, direction);
+}
+
+static int is_permutation(int *permutation, int length)
+{
+    char *seen = calloc(length, 1);/*{{{*/
+    int valid = 1;
+    for (int i = 0; i < length && valid; i++) {
+        int j = permutation[i];
+        valid = j >= 0 && j < length && !seen[j];
+        if (valid)
+            seen[j] = 1;
+    }
+
+    free(seen);
+    return valid;/*}}}*/
+}
+
+// quadratic permutation polynomial: pi(i) = (f1*i + f2*i^2) mod length.
+// Returns NULL if the coefficients do not give a permutation
+int *interleaver_qpp(int length, int f1, int f2)
+{
+    int *pi = malloc(length * sizeof *pi);/*{{{*/
+    long long K = length;
+    long long a = ((f1 % K) + K) % K;
+    long long b = ((f2 % K) + K) % K;
+
+    for (long long i = 0; i < K; i++)
+        pi[i] = (int) ((a*i + b*i % K * i) % K);
+
+    if (!is_permutation(pi, length)) {
+        free(pi);
+        return NULL;
+    }
+
+    return pi;/*}}}*/
+}
+
+// almost regular permutation: pi(i) = (P*i + shifts[i mod period]) mod length,
+// a regular permutation perturbed with a periodic pattern. Returns NULL if
+// the parameters do not give a permutation
+int *interleaver_arp(int length, int P, int period, int *shifts)
+{
+    if (period <= 0 || length % period)/*{{{*/
+        return NULL;
+
+    int *pi = malloc(length * sizeof *pi);
+    long long K = length;
+    for (long long i = 0; i < K; i++)
+        pi[i] = (int) ((((P % K)*i + shifts[i % period]) % K + K) % K);
+
+    if (!is_permutation(pi, length)) {
+        free(pi);
+        return NULL;
+    }
+
+    return pi;/*}}}*/
+}
+
+// build an interleaver from "qpp:F1,F2" or "arp:P,S0,S1,...", NULL if the
+// description is invalid for this length
+int *interleaver_parse(char *spec, int length)
+{
+    long int values[INTERLEAVER_MAX_PARAMETERS];/*{{{*/
+    int count = 0;
+
+    char *colon = strchr(spec, ':');
+    if (!colon)
+        return NULL;
+
+    char *cursor = colon + 1;
+    while (*cursor && count < INTERLEAVER_MAX_PARAMETERS) {
+        char *end;
+        values[count++] = strtol(cursor, &end, 10);
+        if (end == cursor || (*end && *end != ','))
+            return NULL;
+        cursor = *end ? end + 1 : end;
+    }
+
+    if (*cursor)
+        return NULL;
+
+    if (!strncmp(spec, "qpp:", 4) && count == 2)
+        return interleaver_qpp(length, (int) values[0], (int) values[1]);
+
+    if (!strncmp(spec, "arp:", 4) && count >= 2) {
+        int shifts[INTERLEAVER_MAX_PARAMETERS];
+        for (int i = 1; i < count; i++)
+            shifts[i - 1] = (int) values[i];
+        return interleaver_arp(length, (int) values[0], count - 1, shifts);
+    }
+
+    return NULL;/*}}}*/
+}
+
+// the frame is split in parallelism windows of length / parallelism bits,
+// decoded side by side: at every step the workers read one bit each through
+// the permutation, and the access is contention-free if those bits lie in
+// distinct windows, in both directions. Returns 1 if it is, 0 if it is not
+// and -1 if the windows can't have the same length
+int interleaver_contention_free(int *permutation, int length, int parallelism)
+{
+    if (parallelism <= 0 || length % parallelism)/*{{{*/
+        return -1;
+
+    int window = length / parallelism;
+    int *inverse = malloc(length * sizeof *inverse);
+    for (int i = 0; i < length; i++)
+        inverse[permutation[i]] = i;
+
+    char *busy = malloc(parallelism);
+    int free_of_contention = 1;
+    int *tables[2] = {permutation, inverse};
+
+    for (int d = 0; d < 2 && free_of_contention; d++) {
+        for (int t = 0; t < window && free_of_contention; t++) {
+            memset(busy, 0, parallelism);
+            for (int w = 0; w < parallelism && free_of_contention; w++) {
+                int bank = tables[d][t + w*window] / window;
+                free_of_contention = !busy[bank];
+                busy[bank] = 1;
+            }
+        }
+    }
+
+    free(busy);
+    free(inverse);
+    return free_of_contention;/*}}}*/
+}
@@ -0,0 +1,36 @@
+#ifndef DEEPSPACE_TURBO_LIBINTERLEAVER_H
+#define DEEPSPACE_TURBO_LIBINTERLEAVER_H
+
+#define INTERLEAVE 0
+#define DEINTERLEAVE 1
+
+// a permutation and its inverse: interleaved[i] = packet[forward[i]] and
+// packet[i] = interleaved[inverse[i]], so both directions are gathers.
+// The forward table belongs to the caller, the inverse to the interleaver
+typedef struct str_interleaver{
+    int length;
+    int *forward;
+    int *inverse;
+} t_interleaver;
+
+t_interleaver *interleaver_initialize(int *permutation, int length);
+void interleaver_clear(t_interleaver *pi);
+
+// out and in must not overlap
+void interleaver_apply(t_interleaver *pi, double *out, double *in, int direction);
+void interleaver_apply_bits(t_interleaver *pi, int *out, int *in, int direction);
+void interleaver_apply_pair(t_interleaver *pi, double *out[2], double *in[2], int direction);
+void interleaver_apply_pair_float(t_interleaver *pi, float *out[2], float *in[2], int direction);
+
+// scratch holds at least pi->length values
+void interleaver_apply_inplace(t_interleaver *pi, double *data, double *scratch, int direction);
+
+// permutation families for parallel decoders, see libinterleaver.c
+#define INTERLEAVER_MAX_PARAMETERS 64
+
+int *interleaver_qpp(int length, int f1, int f2);
+int *interleaver_arp(int length, int P, int period, int *shifts);
+int *interleaver_parse(char *spec, int length);
+int interleaver_contention_free(int *permutation, int length, int parallelism);
+
+#endif //DEEPSPACE_TURBO_LIBINTERLEAVER_H
@@ -0,0 +1,1156 @@
+#include "libsimulation.h"
+#include "utilities.h"
+#include "profiling.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <signal.h>
+#include <unistd.h>
+
+// unsigned longs between the commit sequences of two workers, a cache line
+#define COMMIT_STRIDE 8
+
+
+t_simulation *simulation_initialize(void)
+{
+    t_simulation *sim = malloc(sizeof *sim);/*{{{*/
+
+    sim->num_packets = 30;
+    sim->min_errors = 10;
+    sim->precision = 0.1;
+    sim->confidence = 0.95;
+    sim->prune = 0;
+    sim->prune_check = 0.05;
+    sim->batch_size = 0;
+    sim->threads = 1;
+    sim->seed = 0;
+    sim->shard = 0;
+    sim->shards = 1;
+    sim->shard_packets = 0;
+
+    sim->completed_packets = 0;
+    sim->progress_interval = 10;
+    sim->status_file = NULL;
+
+    sim->batches = 0;
+    sim->batch_done = NULL;
+    sim->workers = 0;
+    sim->commit_sequence = NULL;
+    pthread_mutex_init(&sim->lock, NULL);
+    sim->checkpoint_file = NULL;
+    sim->checkpoint_interval = 600;
+    sim->interrupted = 0;
+
+    sim->configs_count = 0;
+    sim->configs = NULL;
+    sim->groups_count = 0;
+    sim->groups = NULL;
+    sim->components_count = 0;
+    sim->components = NULL;
+
+    return sim;/*}}}*/
+}
+
+// look up the single-output encoder with the given connections, create it if needed
+static int simulation_component(t_simulation *sim, t_convcode *code, int c, int group, int lower)
+{
+    for (int i = 0; i < sim->components_count; i++) {/*{{{*/
+        t_simcomponent *comp = &sim->components[i];
+        if (comp->group != group || comp->lower != lower || comp->code->memory != code->memory)
+            continue;
+
+        int same = 1;
+        for (int j = 0; j < code->memory; j++)
+            same = same && comp->code->backward_connections[j] == code->backward_connections[j];
+        for (int j = 0; j <= code->memory; j++)
+            same = same && comp->code->forward_connections[0][j] == code->forward_connections[c][j];
+
+        if (same)
+            return i;
+    }
+
+    // rebuild the connection strings of the selected output
+    char *forward = malloc(code->memory + 2);
+    char *backward = malloc(code->memory + 1);
+    for (int j = 0; j <= code->memory; j++)
+        forward[j] = '0' + code->forward_connections[c][j];
+    for (int j = 0; j < code->memory; j++)
+        backward[j] = '0' + code->backward_connections[j];
+    forward[code->memory + 1] = '\0';
+    backward[code->memory] = '\0';
+
+    sim->components = realloc(sim->components, (sim->components_count + 1) * sizeof *sim->components);
+    t_simcomponent *comp = &sim->components[sim->components_count];
+    comp->code = convcode_initialize(&forward, backward, 1);
+    comp->group = group;
+    comp->lower = lower;
+
+    free(forward);
+    free(backward);
+
+    return sim->components_count++;/*}}}*/
+}
+
+int simulation_add_config(t_simulation *sim, char *name, t_turbocode *code, int *puncturing_pattern, double rate,
+                          int iterations, double *EbN0_dB, int SNR_points)
+{
+    sim->configs = realloc(sim->configs, (sim->configs_count + 1) * sizeof *sim->configs);/*{{{*/
+    t_simconfig *config = &sim->configs[sim->configs_count];
+
+    config->name = malloc(strlen(name) + 1);
+    strcpy(config->name, name);
+    config->code = code;
+    config->puncturing_pattern = puncturing_pattern;
+    config->rate = rate;
+    config->iterations = iterations;
+    config->num_packets = sim->num_packets;
+    config->min_errors = sim->min_errors;
+    config->precision = sim->precision;
+
+    // find the group of codes sharing packet length and interleaver
+    config->group = -1;
+    for (int g = 0; g < sim->groups_count; g++)
+        if (sim->groups[g].packet_length == code->packet_length && sim->groups[g].interleaver == code->interleaver)
+            config->group = g;
+
+    if (config->group < 0) {
+        sim->groups = realloc(sim->groups, (sim->groups_count + 1) * sizeof *sim->groups);
+        sim->groups[sim->groups_count].packet_length = code->packet_length;
+        sim->groups[sim->groups_count].interleaver = code->interleaver;
+        config->group = sim->groups_count++;
+    }
+
+    // outputs of the upper and lower codes are computed once per group
+    int upper = code->upper_code->components;
+    int lower = code->lower_code->components;
+    config->components = malloc((upper + lower) * sizeof *config->components);
+    for (int c = 0; c < upper; c++)
+        config->components[c] = simulation_component(sim, code->upper_code, c, config->group, 0);
+    for (int c = 0; c < lower; c++)
+        config->components[upper + c] = simulation_component(sim, code->lower_code, c, config->group, 1);
+
+    // get noise std variation from SNR
+    config->SNR_points = SNR_points;
+    config->points = calloc(SNR_points, sizeof *config->points);
+    config->prior = calloc(SNR_points, sizeof *config->prior);
+    config->code_type = 0;
+    config->octets = 0;
+    for (int i = 0; i < SNR_points; i++) {
+        double EbN0 = pow(10, EbN0_dB[i]/10.0);
+        config->points[i].EbN0_dB = EbN0_dB[i];
+        config->points[i].sigma = sqrt(1.0/(EbN0*2*rate));
+    }
+
+    return sim->configs_count++;/*}}}*/
+}
+
+void simulation_clear(t_simulation *sim)
+{
+    for (int i = 0; i < sim->configs_count; i++) {/*{{{*/
+        free(sim->configs[i].name);
+        free(sim->configs[i].components);
+        free(sim->configs[i].points);
+        free(sim->configs[i].prior);
+    }
+
+    for (int i = 0; i < sim->components_count; i++) {
+        convcode_clear(sim->components[i].code);
+        free(sim->components[i].code);
+    }
+
+    free(sim->configs);
+    free(sim->groups);
+    free(sim->components);
+    free(sim->batch_done);
+    pthread_mutex_destroy(&sim->lock);/*}}}*/
+}
+
+static void taskqueue_push(t_taskqueue *queue, t_task task)
+{
+    queue->tasks[queue->tail++] = task;
+}
+
+// owner side: take the oldest task
+static int taskqueue_pop(t_taskqueue *queue, t_task *task)
+{
+    int found = 0;/*{{{*/
+    omp_set_lock(&queue->lock);
+    if (queue->head < queue->tail) {
+        *task = queue->tasks[queue->head++];
+        found = 1;
+    }
+    omp_unset_lock(&queue->lock);
+
+    return found;/*}}}*/
+}
+
+// thief side: take the newest task, the one the owner would reach last
+static int taskqueue_steal(t_taskqueue *queue, t_task *task)
+{
+    int found = 0;/*{{{*/
+    omp_set_lock(&queue->lock);
+    if (queue->head < queue->tail) {
+        *task = queue->tasks[--queue->tail];
+        found = 1;
+    }
+    omp_unset_lock(&queue->lock);
+
+    return found;/*}}}*/
+}
+
+static int point_retired(t_simpoint *point)
+{
+    int retired;
+    #pragma omp atomic read
+    retired = point->retired;
+
+    return retired;
+}
+
+t_estimate simulation_estimate(t_simpoint *point, int info_length, double confidence)
+{
+    t_estimate estimate;/*{{{*/
+    double z = normal_quantile(0.5 + confidence/2);
+    long int n = point->processed_packets;
+    double bits = (double) n * info_length;
+
+    estimate.PER = n ? (double) point->erroneous_packets / n : 0;
+    wilson_interval(point->erroneous_packets, n, z, &estimate.PER_low, &estimate.PER_high);
+
+    estimate.BER = n ? point->errors / bits : 0;
+    if (point->erroneous_packets < 2) {
+        // not enough error events to estimate the spread: treat bits as independent
+        wilson_interval(point->errors, (long int) bits, z, &estimate.BER_low, &estimate.BER_high);
+    } else {
+        // errors are bursty within a packet: use the spread of the
+        // per-packet error counts (central limit theorem over packets)
+        double mean = (double) point->errors / n;
+        double variance = ((double) point->errors_squared / n - mean*mean) * n / (n - 1);
+        double half_width = z * sqrt(variance > 0 ? variance / n : 0) / info_length;
+
+        estimate.BER_low = estimate.BER - half_width > 0 ? estimate.BER - half_width : 0;
+        estimate.BER_high = estimate.BER + half_width;
+    }
+
+    return estimate;/*}}}*/
+}
+
+// counters of this run and of the earlier runs loaded from a results store
+void simulation_total(t_simconfig *config, int s, t_simpoint *total)
+{
+    t_simpoint *point = &config->points[s];/*{{{*/
+    t_simpoint *prior = &config->prior[s];
+    *total = *point;
+
+    #pragma omp atomic read
+    total->errors = point->errors;
+    #pragma omp atomic read
+    total->errors_squared = point->errors_squared;
+    #pragma omp atomic read
+    total->erroneous_packets = point->erroneous_packets;
+    #pragma omp atomic read
+    total->processed_packets = point->processed_packets;
+
+    total->errors += prior->errors;
+    total->errors_squared += prior->errors_squared;
+    total->erroneous_packets += prior->erroneous_packets;
+    total->processed_packets += prior->processed_packets;
+    total->pruned_packets += prior->pruned_packets;
+    total->checked_packets += prior->checked_packets;
+    total->violations += prior->violations;/*}}}*/
+}
+
+// check whether the stopping rules are met for a point
+static int point_settled(t_simulation *sim, t_simconfig *config, t_simpoint *point)
+{
+    t_simpoint snapshot;/*{{{*/
+    simulation_total(config, (int) (point - config->points), &snapshot);
+
+    if (snapshot.processed_packets >= config->num_packets)
+        return 1;
+
+    if (snapshot.erroneous_packets < config->min_errors)
+        return 0;
+
+    t_estimate e = simulation_estimate(&snapshot, config->code->packet_length, sim->confidence);
+    double BER_precision = (e.BER_high - e.BER_low) / (2 * e.BER);
+    double PER_precision = (e.PER_high - e.PER_low) / (2 * e.PER);
+
+    return BER_precision <= config->precision && PER_precision <= config->precision;/*}}}*/
+}
+
+// apply the stopping rules to every point, return the number of retired points
+int simulation_retire(t_simulation *sim)
+{
+    int retired = 0;/*{{{*/
+    for (int c = 0; c < sim->configs_count; c++) {
+        for (int s = 0; s < sim->configs[c].SNR_points; s++) {
+            sim->configs[c].points[s].retired = point_settled(sim, &sim->configs[c], &sim->configs[c].points[s]);
+            retired += sim->configs[c].points[s].retired;
+        }
+    }
+
+    return retired;/*}}}*/
+}
+
+// assemble the codeword of a configuration from the streams of the shared components
+static void simulation_encode(t_workspace *ws, t_simconfig *config)
+{
+    t_turbocode *code = config->code;/*{{{*/
+    int upper = code->upper_code->components;
+    int lower = code->lower_code->components;
+    int codewords = code->packet_length + code->upper_code->memory;
+
+    // parallel to serial, same order as turbo_encode
+    int k = 0;
+    for (int cw = 0; cw < codewords; cw++) {
+        for (int c = 0; c < upper; c++)
+            ws->encoded[k++] = ws->streams[config->components[c]][cw];
+        for (int c = 0; c < lower; c++)
+            ws->encoded[k++] = ws->streams[config->components[upper + c]][cw];
+    }/*}}}*/
+}
+
+// decode a packet at the active points of a configuration, counters go to deltas
+static void simulation_config(t_simulation *sim, t_workspace *ws, t_simconfig *config, t_simpoint *deltas, int check)
+{
+    t_turbocode *code = config->code;/*{{{*/
+    int info_length = code->packet_length;
+    int encoded_length = code->encoded_length;
+
+    int active = 0;
+    for (int s = 0; s < config->SNR_points; s++)
+        if (!point_retired(&config->points[s]))
+            ws->active[active++] = s;
+
+    if (!active)
+        return;
+
+    // the components were encoded once for the packet, the codeword of the
+    // configuration is assembled as part of its modulation
+    PROFILE_BEGIN(PROFILE_MODULATION);
+    simulation_encode(ws, config);
+
+    // derive the received signals of every active point in a single pass
+    for (int i = 0; i < encoded_length; i++) {
+        int mask = (config->puncturing_pattern) ? config->puncturing_pattern[i] : 1;
+        double x = mask * (2 * ws->encoded[i] - 1);
+        double n = mask * ws->noise[i];
+        for (int a = 0; a < active; a++)
+            ws->received[a*encoded_length + i] = x + config->points[ws->active[a]].sigma * n;
+    }
+    PROFILE_END(PROFILE_MODULATION);
+
+    // points are sorted by increasing SNR
+    int succeeded = 0;
+    for (int a = 0; a < active; a++) {
+        t_simpoint *delta = &deltas[ws->active[a]];
+        double sigma = config->points[ws->active[a]].sigma;
+        int errors = 0;
+
+        if (sim->prune && succeeded && !check) {
+            delta->pruned_packets++;
+        } else {
+            int *decoded = turbo_decode(&ws->received[a*encoded_length], config->iterations, sigma*sigma, code);
+            for (int j = 0; j < info_length; ++j)
+                errors += (decoded[j] != ws->packet[j]);
+            free(decoded);
+
+            if (sim->prune && succeeded) {
+                delta->checked_packets++;
+                delta->violations += errors != 0;
+            }
+
+            succeeded = succeeded || !errors;
+        }
+
+        delta->errors = errors;
+        delta->errors_squared = (long int) errors * errors;
+        delta->erroneous_packets = errors != 0;
+        delta->processed_packets = 1;
+    }/*}}}*/
+}
+
+// add the counters of a packet to the totals and record it in its batch. The
+// commit sequence lets the checkpoint writer see the totals of whole packets
+// from the start of each batch without making the workers take a lock
+static void simulation_commit(t_simulation *sim, t_workspace *ws, int batch)
+{
+    unsigned long *sequence = &sim->commit_sequence[ws->worker * COMMIT_STRIDE];/*{{{*/
+    unsigned long start = *sequence;
+    __atomic_store_n(sequence, start + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+
+    for (int c = 0; c < sim->configs_count; c++) {
+        t_simconfig *config = &sim->configs[c];
+        for (int s = 0; s < config->SNR_points; s++) {
+            t_simpoint *point = &config->points[s];
+            t_simpoint *delta = &ws->deltas[c][s];
+            if (!delta->processed_packets)
+                continue;
+
+            // the reporter and the checkpoint writer read the totals concurrently
+            #pragma omp atomic
+            point->errors += delta->errors;
+            #pragma omp atomic
+            point->errors_squared += delta->errors_squared;
+            #pragma omp atomic
+            point->erroneous_packets += delta->erroneous_packets;
+            #pragma omp atomic
+            point->processed_packets += delta->processed_packets;
+            #pragma omp atomic
+            point->pruned_packets += delta->pruned_packets;
+            #pragma omp atomic
+            point->checked_packets += delta->checked_packets;
+            #pragma omp atomic
+            point->violations += delta->violations;
+            memset(delta, 0, sizeof *delta);
+
+            if (point_settled(sim, config, point)) {
+                #pragma omp atomic write
+                point->retired = 1;
+            }
+        }
+    }
+
+    #pragma omp atomic
+    sim->batch_done[batch]++;
+    __atomic_store_n(sequence, start + 2, __ATOMIC_RELEASE);
+
+    #pragma omp atomic
+    sim->completed_packets++;/*}}}*/
+}
+
+static volatile sig_atomic_t interrupt_requested = 0;
+
+static void simulation_interrupt(int signal)
+{
+    interrupt_requested = 1;
+}
+
+static int simulation_done(t_simulation *sim)
+{
+    // stop at packet boundaries on SIGINT/SIGTERM, the checkpoint stays consistent/*{{{*/
+    if (interrupt_requested)
+        return 1;
+
+    for (int c = 0; c < sim->configs_count; c++)
+        for (int s = 0; s < sim->configs[c].SNR_points; s++)
+            if (!point_retired(&sim->configs[c].points[s]))
+                return 0;
+
+    return 1;/*}}}*/
+}
+
+static void simulation_task(t_simulation *sim, t_workspace *ws, t_task *task)
+{
+    for (int k = task->first_packet; k < task->first_packet + task->count; k++) {/*{{{*/
+        if (simulation_done(sim))
+            return;
+
+        // every configuration and SNR point sees the same packet and noise
+        // realization: shorter packets and codewords use a prefix
+        t_rng rng;
+        rng_seed(&rng, sim->seed, (uint64_t) k);
+        PROFILE_BEGIN(PROFILE_PACKET_GENERATION);
+        rng_fill_bits(&rng, ws->packet, ws->packet_length);
+        PROFILE_END(PROFILE_PACKET_GENERATION);
+
+        PROFILE_BEGIN(PROFILE_NOISE_GENERATION);
+        rng_fill_normal(&rng, ws->noise, 0, 1, ws->encoded_length);
+        PROFILE_END(PROFILE_NOISE_GENERATION);
+        int check = rng_uniform(&rng) <= sim->prune_check;
+
+        // encode once with each distinct component
+        PROFILE_BEGIN(PROFILE_ENCODE);
+        for (int g = 0; g < sim->groups_count; g++)
+            for (int j = 0; j < sim->groups[g].packet_length; ++j)
+                ws->interleaved[g][j] = ws->packet[sim->groups[g].interleaver[j]];
+
+        for (int c = 0; c < sim->components_count; c++) {
+            t_simcomponent *comp = &sim->components[c];
+            int *input = comp->lower ? ws->interleaved[comp->group] : ws->packet;
+            convcode_encode_into(ws->streams[c], input, sim->groups[comp->group].packet_length, comp->code);
+        }
+        PROFILE_END(PROFILE_ENCODE);
+
+        for (int c = 0; c < sim->configs_count; c++)
+            simulation_config(sim, ws, &sim->configs[c], ws->deltas[c], check);
+
+        simulation_commit(sim, ws, task->batch);
+    }/*}}}*/
+}
+
+static void workspace_initialize(t_workspace *ws, t_simulation *sim)
+{
+    int max_points = 0;/*{{{*/
+    ws->packet_length = 0;
+    ws->encoded_length = 0;
+    for (int c = 0; c < sim->configs_count; c++) {
+        t_simconfig *config = &sim->configs[c];
+        if (config->code->packet_length > ws->packet_length)
+            ws->packet_length = config->code->packet_length;
+        if (config->code->encoded_length > ws->encoded_length)
+            ws->encoded_length = config->code->encoded_length;
+        if (config->SNR_points > max_points)
+            max_points = config->SNR_points;
+    }
+
+    ws->packet = malloc(ws->packet_length * sizeof *ws->packet);
+    ws->encoded = malloc(ws->encoded_length * sizeof *ws->encoded);
+    ws->noise = malloc(ws->encoded_length * sizeof *ws->noise);
+    ws->received = malloc((size_t) max_points * ws->encoded_length * sizeof *ws->received);
+    ws->active = malloc(max_points * sizeof *ws->active);
+
+    ws->interleaved = malloc(sim->groups_count * sizeof *ws->interleaved);
+    for (int g = 0; g < sim->groups_count; g++)
+        ws->interleaved[g] = malloc(sim->groups[g].packet_length * sizeof(int));
+
+    ws->streams = malloc(sim->components_count * sizeof *ws->streams);
+    for (int c = 0; c < sim->components_count; c++) {
+        t_simcomponent *comp = &sim->components[c];
+        int length = sim->groups[comp->group].packet_length + comp->code->memory;
+        ws->streams[c] = malloc(length * sizeof(int));
+    }
+
+    ws->deltas = malloc(sim->configs_count * sizeof *ws->deltas);
+    for (int c = 0; c < sim->configs_count; c++)
+        ws->deltas[c] = calloc(sim->configs[c].SNR_points, sizeof(t_simpoint));/*}}}*/
+}
+
+static void workspace_clear(t_workspace *ws, t_simulation *sim)
+{
+    for (int g = 0; g < sim->groups_count; g++)/*{{{*/
+        free(ws->interleaved[g]);
+    for (int c = 0; c < sim->components_count; c++)
+        free(ws->streams[c]);
+    for (int c = 0; c < sim->configs_count; c++)
+        free(ws->deltas[c]);
+    free(ws->deltas);
+
+    free(ws->interleaved);
+    free(ws->streams);
+    free(ws->packet);
+    free(ws->encoded);
+    free(ws->noise);
+    free(ws->received);
+    free(ws->active);/*}}}*/
+}
+
+static double seconds_since(struct timespec *start)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - start->tv_sec) + 1e-9 * (now.tv_nsec - start->tv_nsec);
+}
+
+// print rate, ETA and the running estimates of every SNR point
+void simulation_report(t_simulation *sim, FILE *file, double elapsed)
+{
+    long int completed;/*{{{*/
+    #pragma omp atomic read
+    completed = sim->completed_packets;
+
+    // the budget is an upper bound: points may retire earlier
+    double rate = elapsed > 0 ? completed / elapsed : 0;
+    double eta = rate > 0 ? (sim->shard_packets - completed) / rate : 0;
+    fprintf(file, "elapsed %.0f s, packets %ld/%ld, %.2f packets/s, ETA %.0f s\n", elapsed, completed,
+            sim->shard_packets, rate, eta);
+
+    for (int c = 0; c < sim->configs_count; c++) {
+        t_simconfig *config = &sim->configs[c];
+        if (sim->configs_count > 1)
+            fprintf(file, "%s\n", config->name);
+
+        fprintf(file, "%12s%12s%12s%12s%14s%10s\n", "EbN0 [dB]", "errors", "err. pkts", "packets", "BER", "status");
+        for (int s = 0; s < config->SNR_points; s++) {
+            t_simpoint *point = &config->points[s];
+            t_simpoint snapshot = *point;
+            #pragma omp atomic read
+            snapshot.errors = point->errors;
+            #pragma omp atomic read
+            snapshot.erroneous_packets = point->erroneous_packets;
+            #pragma omp atomic read
+            snapshot.processed_packets = point->processed_packets;
+
+            t_estimate e = simulation_estimate(&snapshot, config->code->packet_length, sim->confidence);
+            fprintf(file, "%12.3f%12ld%12ld%12ld%14.4e%10s\n", snapshot.EbN0_dB, snapshot.errors,
+                    snapshot.erroneous_packets, snapshot.processed_packets, e.BER,
+                    point_retired(point) ? "done" : "running");
+        }
+    }/*}}}*/
+}
+
+// write the report to a temporary file and rename it, so that readers never see a partial status
+static void simulation_status(t_simulation *sim, double elapsed)
+{
+    char tmp[4096];/*{{{*/
+    snprintf(tmp, sizeof(tmp), "%s.tmp", sim->status_file);
+
+    FILE *file = fopen(tmp, "w");
+    if (!file)
+        return;
+    simulation_report(sim, file, elapsed);
+    fclose(file);
+    rename(tmp, sim->status_file);/*}}}*/
+}
+
+typedef struct str_reporter{
+    t_simulation *sim;
+    struct timespec start;
+    volatile int stop;
+} t_reporter;
+
+// progress reports and checkpoints, each on its own period
+static void *reporter_thread(void *arg)
+{
+    t_reporter *reporter = arg;/*{{{*/
+    t_simulation *sim = reporter->sim;
+    double next_report = sim->progress_interval;
+    double next_checkpoint = sim->checkpoint_interval;
+
+    // wake up often enough to stop promptly
+    struct timespec nap = {0, 100000000};
+    while (!__atomic_load_n(&reporter->stop, __ATOMIC_ACQUIRE)) {
+        nanosleep(&nap, NULL);
+        double elapsed = seconds_since(&reporter->start);
+
+        if (sim->progress_interval > 0 && elapsed >= next_report) {
+            next_report = elapsed + sim->progress_interval;
+            printf("\n");
+            simulation_report(sim, stdout, elapsed);
+            fflush(stdout);
+            if (sim->status_file)
+                simulation_status(sim, elapsed);
+        }
+
+        if (sim->checkpoint_file && sim->checkpoint_interval > 0 && elapsed >= next_checkpoint) {
+            next_checkpoint = elapsed + sim->checkpoint_interval;
+            if (simulation_save_checkpoint(sim, sim->checkpoint_file))
+                perror("Couldn't save checkpoint");
+        }
+    }
+
+    return NULL;/*}}}*/
+}
+
+// split the packets in batches, the layout is fixed once chosen so that a
+// checkpoint can be resumed
+static void simulation_batches(t_simulation *sim)
+{
+    int threads = sim->threads > 0 ? sim->threads : 1;/*{{{*/
+
+    // by default aim for a few dozen tasks per worker. Shards may run on
+    // different numbers of cores, so they must agree on a layout that only
+    // depends on the packet count and the number of shards
+    if (sim->batch_size <= 0 && sim->shards > 1)
+        sim->batch_size = (sim->num_packets + 256*sim->shards - 1) / (256*sim->shards);
+    else if (sim->batch_size <= 0)
+        sim->batch_size = (sim->num_packets + 64*threads - 1) / (64*threads);
+    sim->batch_size = sim->batch_size > 0 ? sim->batch_size : 1;
+
+    int batches = (sim->num_packets + sim->batch_size - 1) / sim->batch_size;
+    if (batches > sim->batches) {
+        sim->batch_done = realloc(sim->batch_done, batches * sizeof *sim->batch_done);
+        memset(sim->batch_done + sim->batches, 0, (batches - sim->batches) * sizeof *sim->batch_done);
+        sim->batches = batches;
+    }
+
+    sim->shard_packets = 0;
+    for (int b = sim->shard; b < batches; b += sim->shards)
+        sim->shard_packets += (b + 1) * sim->batch_size > sim->num_packets ? sim->num_packets - b * sim->batch_size :
+                              sim->batch_size;/*}}}*/
+}
+
+void simulation_run(t_simulation *sim)
+{
+    int threads = sim->threads > 0 ? sim->threads : 1;/*{{{*/
+
+    simulation_batches(sim);
+    int batch = sim->batch_size;
+    int batches = sim->batches;
+    int tasks_per_queue = (batches + threads - 1) / threads;
+
+    t_taskqueue *queues = malloc(threads * sizeof *queues);
+    for (int t = 0; t < threads; t++) {
+        queues[t].tasks = malloc(tasks_per_queue * sizeof(t_task));
+        queues[t].head = 0;
+        queues[t].tail = 0;
+        omp_init_lock(&queues[t].lock);
+    }
+
+    // workers never print: a single thread reports their progress and saves checkpoints
+    t_reporter reporter = {sim, {0, 0}, 0};
+    pthread_t reporter_id;
+    clock_gettime(CLOCK_MONOTONIC, &reporter.start);
+    int reporting = (sim->progress_interval > 0 || sim->checkpoint_file) &&
+                    !pthread_create(&reporter_id, NULL, reporter_thread, &reporter);
+
+    // an interrupted run can be resumed from its checkpoint
+    struct sigaction action, previous_int, previous_term;
+    if (sim->checkpoint_file) {
+        memset(&action, 0, sizeof action);
+        action.sa_handler = simulation_interrupt;
+        sigemptyset(&action.sa_mask);
+        sigaction(SIGINT, &action, &previous_int);
+        sigaction(SIGTERM, &action, &previous_term);
+    }
+
+    sim->workers = threads;
+    sim->commit_sequence = calloc(threads * COMMIT_STRIDE, sizeof *sim->commit_sequence);
+
+    // deal the batches of this shard round-robin, skipping the packets already committed
+    for (int b = sim->shard; b < batches; b += sim->shards) {
+        t_task task;
+        int count = (b + 1) * batch > sim->num_packets ? sim->num_packets - b * batch : batch;
+        task.batch = b;
+        task.first_packet = b * batch + sim->batch_done[b];
+        task.count = count - sim->batch_done[b];
+        if (task.count > 0)
+            taskqueue_push(&queues[(b / sim->shards) % threads], task);
+    }
+
+    #pragma omp parallel num_threads(threads)
+    {
+        int self = omp_get_thread_num();
+        t_task task;
+
+        t_workspace ws;
+        workspace_initialize(&ws, sim);
+        ws.worker = self;
+
+        while (1) {
+            int found = taskqueue_pop(&queues[self], &task);
+
+            // own queue is empty: try to steal from the other workers.
+            // No task spawns new ones, so when every queue is empty we are done
+            for (int v = 1; v < threads && !found; v++)
+                found = taskqueue_steal(&queues[(self + v) % threads], &task);
+
+            // SNR points that met their stopping rules are retired; once
+            // all of them are, the remaining tasks are dropped
+            if (!found || simulation_done(sim))
+                break;
+
+            simulation_task(sim, &ws, &task);
+        }
+
+        workspace_clear(&ws, sim);
+    }
+
+    if (reporting) {
+        __atomic_store_n(&reporter.stop, 1, __ATOMIC_RELEASE);
+        pthread_join(reporter_id, NULL);
+    }
+
+    // no commit can overlap the last checkpoint
+    free(sim->commit_sequence);
+    sim->commit_sequence = NULL;
+    sim->workers = 0;
+    if (sim->status_file)
+        simulation_status(sim, seconds_since(&reporter.start));
+
+    if (sim->checkpoint_file) {
+        sigaction(SIGINT, &previous_int, NULL);
+        sigaction(SIGTERM, &previous_term, NULL);
+        sim->interrupted = interrupt_requested;
+        interrupt_requested = 0;
+
+        if (simulation_save_checkpoint(sim, sim->checkpoint_file))
+            perror("Couldn't save checkpoint");
+    }
+
+    for (int t = 0; t < threads; t++) {
+        omp_destroy_lock(&queues[t].lock);
+        free(queues[t].tasks);
+    }
+    free(queues);/*}}}*/
+}
+
+// copy the counters and the batch positions when no commit overlaps the
+// copy: the snapshot covers whole packets from the start of each batch
+static void simulation_snapshot(t_simulation *sim, t_simpoint **points, int *batch_done)
+{
+    int workers = sim->workers;/*{{{*/
+    unsigned long before[workers > 0 ? workers : 1];
+    struct timespec nap = {0, 100000};
+
+    while (1) {
+        int busy = 0;
+        for (int w = 0; w < workers; w++) {
+            before[w] = __atomic_load_n(&sim->commit_sequence[w * COMMIT_STRIDE], __ATOMIC_ACQUIRE);
+            busy = busy || before[w] % 2;
+        }
+
+        if (!busy) {
+            for (int c = 0; c < sim->configs_count; c++) {
+                for (int s = 0; s < sim->configs[c].SNR_points; s++) {
+                    t_simpoint *point = &sim->configs[c].points[s];
+                    t_simpoint *copy = &points[c][s];
+                    copy->EbN0_dB = point->EbN0_dB;
+                    copy->errors = __atomic_load_n(&point->errors, __ATOMIC_RELAXED);
+                    copy->errors_squared = __atomic_load_n(&point->errors_squared, __ATOMIC_RELAXED);
+                    copy->erroneous_packets = __atomic_load_n(&point->erroneous_packets, __ATOMIC_RELAXED);
+                    copy->processed_packets = __atomic_load_n(&point->processed_packets, __ATOMIC_RELAXED);
+                    copy->pruned_packets = __atomic_load_n(&point->pruned_packets, __ATOMIC_RELAXED);
+                    copy->checked_packets = __atomic_load_n(&point->checked_packets, __ATOMIC_RELAXED);
+                    copy->violations = __atomic_load_n(&point->violations, __ATOMIC_RELAXED);
+                }
+            }
+            for (int b = 0; b < sim->batches; b++)
+                batch_done[b] = __atomic_load_n(&sim->batch_done[b], __ATOMIC_RELAXED);
+
+            __atomic_thread_fence(__ATOMIC_ACQUIRE);
+            int overlapped = 0;
+            for (int w = 0; w < workers; w++)
+                overlapped = overlapped ||
+                             __atomic_load_n(&sim->commit_sequence[w * COMMIT_STRIDE], __ATOMIC_RELAXED) != before[w];
+            if (!overlapped)
+                return;
+        }
+
+        nanosleep(&nap, NULL);
+    }/*}}}*/
+}
+
+int simulation_save_checkpoint(t_simulation *sim, char *filename)
+{
+    char tmp[4096];/*{{{*/
+    snprintf(tmp, sizeof(tmp), "%s.tmp", filename);
+
+    // one writer at a time, the workers keep committing packets
+    pthread_mutex_lock(&sim->lock);
+
+    t_simpoint **points = malloc(sim->configs_count * sizeof *points);
+    for (int c = 0; c < sim->configs_count; c++)
+        points[c] = malloc(sim->configs[c].SNR_points * sizeof *points[c]);
+    int *batch_done = malloc((sim->batches > 0 ? sim->batches : 1) * sizeof *batch_done);
+    simulation_snapshot(sim, points, batch_done);
+
+    FILE *file = fopen(tmp, "w");
+    if (!file) {
+        for (int c = 0; c < sim->configs_count; c++)
+            free(points[c]);
+        free(points);
+        free(batch_done);
+        pthread_mutex_unlock(&sim->lock);
+        return -1;
+    }
+
+    fprintf(file, "# deepspace_turbo checkpoint\n");
+    fprintf(file, "version=1\n");
+    fprintf(file, "seed=%llu\n", (unsigned long long) sim->seed);
+    fprintf(file, "num_packets=%d\n", sim->num_packets);
+    fprintf(file, "batch_size=%d\n", sim->batch_size);
+    fprintf(file, "shard=%d %d\n", sim->shard, sim->shards);
+    fprintf(file, "prune=%d %.17g\n", sim->prune, sim->prune_check);
+    fprintf(file, "configs=%d\n", sim->configs_count);
+
+    for (int c = 0; c < sim->configs_count; c++) {
+        t_simconfig *config = &sim->configs[c];
+        fprintf(file, "config=%d %s %d %d %d\n", c, config->name, config->code->packet_length, config->iterations,
+                config->SNR_points);
+
+        for (int s = 0; s < config->SNR_points; s++) {
+            t_simpoint *p = &points[c][s];
+            fprintf(file, "point=%d %d %.17g %ld %ld %ld %ld %ld %ld %ld\n", c, s, p->EbN0_dB, p->errors,
+                    p->errors_squared, p->erroneous_packets, p->processed_packets, p->pruned_packets,
+                    p->checked_packets, p->violations);
+        }
+        free(points[c]);
+    }
+    free(points);
+
+    // packets committed from the start of each batch
+    fprintf(file, "batches=%d\n", sim->batches);
+    fprintf(file, "done=");
+    for (int b = 0; b < sim->batches; b++)
+        fprintf(file, "%s%d", b ? " " : "", batch_done[b]);
+    fprintf(file, "\n");
+    free(batch_done);
+
+    // readers see either the previous checkpoint or the new one
+    int failed = fflush(file) || fsync(fileno(file));
+    failed = fclose(file) || failed;
+    failed = failed || rename(tmp, filename);
+    pthread_mutex_unlock(&sim->lock);
+
+    return failed ? -1 : 0;/*}}}*/
+}
+
+int simulation_load_checkpoint(t_simulation *sim, char *filename)
+{
+    FILE *file = fopen(filename, "r");/*{{{*/
+    if (!file) {
+        perror("Couldn't open checkpoint");
+        return -1;
+    }
+
+    char *line = NULL;
+    size_t size = 0;
+    int error = 0;
+    int batches = 0;
+    int prune;
+    double prune_check;
+    unsigned long long seed;
+
+    while (!error && getline(&line, &size, file) > 0) {
+        char *value = strchr(line, '=');
+        if (line[0] == '#' || !value)
+            continue;
+        *value++ = '\0';
+
+        if (!strcmp(line, "version")) {
+            error = strtol(value, NULL, 10) != 1;
+        } else if (!strcmp(line, "seed")) {
+            error = sscanf(value, "%llu", &seed) != 1;
+            sim->seed = seed;
+        } else if (!strcmp(line, "num_packets")) {
+            // the packet budget can only grow
+            error = strtol(value, NULL, 10) > sim->num_packets;
+        } else if (!strcmp(line, "batch_size")) {
+            sim->batch_size = (int) strtol(value, NULL, 10);
+        } else if (!strcmp(line, "shard")) {
+            int shard, shards;
+            error = sscanf(value, "%d %d", &shard, &shards) != 2 || shard != sim->shard || shards != sim->shards;
+        } else if (!strcmp(line, "prune")) {
+            error = sscanf(value, "%d %lf", &prune, &prune_check) != 2 || prune != sim->prune ||
+                    (prune && prune_check != sim->prune_check);
+        } else if (!strcmp(line, "configs")) {
+            error = strtol(value, NULL, 10) != sim->configs_count;
+        } else if (!strcmp(line, "config")) {
+            int c, packet_length, iterations, points;
+            char name[256];
+            error = sscanf(value, "%d %255s %d %d %d", &c, name, &packet_length, &iterations, &points) != 5 ||
+                    c < 0 || c >= sim->configs_count || strcmp(name, sim->configs[c].name) ||
+                    packet_length != sim->configs[c].code->packet_length ||
+                    iterations != sim->configs[c].iterations || points != sim->configs[c].SNR_points;
+        } else if (!strcmp(line, "point")) {
+            int c, s;
+            double EbN0_dB;
+            t_simpoint p;
+            error = sscanf(value, "%d %d %lf %ld %ld %ld %ld %ld %ld %ld", &c, &s, &EbN0_dB, &p.errors,
+                           &p.errors_squared, &p.erroneous_packets, &p.processed_packets, &p.pruned_packets,
+                           &p.checked_packets, &p.violations) != 10 ||
+                    c < 0 || c >= sim->configs_count || s < 0 || s >= sim->configs[c].SNR_points ||
+                    fabs(EbN0_dB - sim->configs[c].points[s].EbN0_dB) > 1e-9;
+            if (!error) {
+                t_simpoint *point = &sim->configs[c].points[s];
+                point->errors = p.errors;
+                point->errors_squared = p.errors_squared;
+                point->erroneous_packets = p.erroneous_packets;
+                point->processed_packets = p.processed_packets;
+                point->pruned_packets = p.pruned_packets;
+                point->checked_packets = p.checked_packets;
+                point->violations = p.violations;
+            }
+        } else if (!strcmp(line, "batches")) {
+            batches = (int) strtol(value, NULL, 10);
+            simulation_batches(sim);
+            error = batches > sim->batches;
+        } else if (!strcmp(line, "done")) {
+            char *end = value;
+            sim->completed_packets = 0;
+            for (int b = 0; b < batches && !error; b++) {
+                sim->batch_done[b] = (int) strtol(end, &end, 10);
+                sim->completed_packets += sim->batch_done[b];
+                error = sim->batch_done[b] < 0 || sim->batch_done[b] > sim->batch_size;
+            }
+        }
+    }
+
+    free(line);
+    fclose(file);
+    if (error || !batches)
+        return -1;
+
+    // the stopping rules may have changed since the checkpoint was saved
+    simulation_retire(sim);
+
+    return 0;/*}}}*/
+}
+
+// raw counters of every point, summed over shards by deepspace_merge
+void simulation_save_counts(t_simulation *sim, FILE *file)
+{
+    fprintf(file, "config,info_length,EbN0,processed_packets,erroneous_packets,errors,errors_squared,bits,"/*{{{*/
+            "pruned_packets,checked_packets,violations,seed,shard,shards\n");
+
+    for (int c = 0; c < sim->configs_count; c++) {
+        t_simconfig *config = &sim->configs[c];
+        int info_length = config->code->packet_length;
+
+        for (int s = 0; s < config->SNR_points; s++) {
+            t_simpoint *p = &config->points[s];
+            fprintf(file, "%s,%d,%.17g,%ld,%ld,%ld,%ld,%.0f,%ld,%ld,%ld,%llu,%d,%d\n", config->name, info_length,
+                    p->EbN0_dB, p->processed_packets, p->erroneous_packets, p->errors, p->errors_squared,
+                    (double) p->processed_packets * info_length, p->pruned_packets, p->checked_packets,
+                    p->violations, (unsigned long long) sim->seed, sim->shard, sim->shards);
+        }
+    }/*}}}*/
+}
+
+static int compare_doubles(const void *a, const void *b)
+{
+    double x = *(const double *) a;
+    double y = *(const double *) b;
+    return (x > y) - (x < y);
+}
+
+t_throughput simulation_throughput(t_simconfig *config, double EbN0_dB, int frames, double duration, int threads,
+                                   uint64_t seed)
+{
+    t_turbocode *code = config->code;/*{{{*/
+    int encoded_length = code->encoded_length;
+    double sigma = sqrt(1.0/(pow(10, EbN0_dB/10.0)*2*config->rate));
+    threads = threads > 0 ? threads : 1;
+
+    // pre-generate the stream of noisy frames, so that only decoding is timed
+    double **stream = malloc(frames * sizeof *stream);
+    int *packet = malloc(code->packet_length * sizeof *packet);
+    for (int f = 0; f < frames; f++) {
+        t_rng rng;
+        rng_seed(&rng, seed, (uint64_t) f);
+        rng_fill_bits(&rng, packet, code->packet_length);
+
+        int *encoded = turbo_encode(packet, code);
+        stream[f] = malloc(encoded_length * sizeof **stream);
+        rng_fill_normal(&rng, stream[f], 0, 1, encoded_length);
+        for (int i = 0; i < encoded_length; i++) {
+            int mask = (config->puncturing_pattern) ? config->puncturing_pattern[i] : 1;
+            stream[f][i] = mask * ((2 * encoded[i] - 1) + sigma * stream[f][i]);
+        }
+        free(encoded);
+    }
+    free(packet);
+
+    double **latencies = malloc(threads * sizeof *latencies);
+    long int *decoded_frames = calloc(threads, sizeof *decoded_frames);
+
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    #pragma omp parallel num_threads(threads)
+    {
+        int self = omp_get_thread_num();
+        long int capacity = 1024;
+        long int n = 0;
+        double *latency = malloc(capacity * sizeof *latency);
+
+        // each worker walks the stream from a different offset
+        for (int f = self % frames; seconds_since(&start) < duration; f = (f + 1) % frames) {
+            struct timespec frame_start;
+            clock_gettime(CLOCK_MONOTONIC, &frame_start);
+            free(turbo_decode(stream[f], config->iterations, sigma*sigma, code));
+
+            if (n == capacity) {
+                capacity *= 2;
+                latency = realloc(latency, capacity * sizeof *latency);
+            }
+            latency[n++] = seconds_since(&frame_start);
+        }
+
+        latencies[self] = latency;
+        decoded_frames[self] = n;
+    }
+
+    t_throughput result;
+    result.seconds = seconds_since(&start);
+
+    // merge per-thread latencies to compute percentiles
+    result.frames = 0;
+    for (int t = 0; t < threads; t++)
+        result.frames += decoded_frames[t];
+
+    double *all = malloc((result.frames ? result.frames : 1) * sizeof *all);
+    long int n = 0;
+    for (int t = 0; t < threads; t++) {
+        memcpy(&all[n], latencies[t], decoded_frames[t] * sizeof *all);
+        n += decoded_frames[t];
+        free(latencies[t]);
+    }
+    qsort(all, result.frames, sizeof *all, compare_doubles);
+
+    long int last = result.frames ? result.frames - 1 : 0;
+    result.latency_p50 = result.frames ? all[(long int) (0.5 * last)] : 0;
+    result.latency_p99 = result.frames ? all[(long int) ceil(0.99 * last)] : 0;
+    result.latency_p999 = result.frames ? all[(long int) ceil(0.999 * last)] : 0;
+    result.frames_per_second = result.frames / result.seconds;
+    result.info_mbps = result.frames_per_second * code->packet_length / 1e6;
+    result.iterations = config->iterations;
+
+    for (int f = 0; f < frames; f++)
+        free(stream[f]);
+    free(stream);
+    free(all);
+    free(latencies);
+    free(decoded_frames);
+
+    return result;/*}}}*/
+}
+
+// thread routines
+int simulate_awgn(int *packet, double *noise_sequence, int packet_length, double sigma)/*{{{*/
+{
+    int errors = 0;/*{{{*/
+    for (int i = 0; i < packet_length; i++){
+        double received = sigma*noise_sequence[i] + (2*packet[i]-1);
+        errors += (received > 0) != packet[i];
+    }
+    return errors;/*}}}*/
+}
+
+int simulate_conv(int *packet, double *noise_sequence, int packet_length, double sigma, t_convcode *code)
+{
+    int errors = 0;/*{{{*/
+    int *encoded = convcode_encode(packet, packet_length, code);
+    int encoded_length = code->components*(packet_length + code->memory);
+
+    double *received = malloc(encoded_length * sizeof *received);
+    for (int i = 0; i < encoded_length; i++)
+        received[i] = (2*encoded[i] - 1) + sigma*noise_sequence[i];
+
+//    int *decoded = convcode_decode(received, encoded_length, code);
+    double **a_priori = malloc(2*sizeof(double*));
+    for (int k = 0; k < 2; ++k) {
+        a_priori[k] = malloc(packet_length * sizeof(double));
+        for (int i = 0; i < packet_length; ++i) {
+            a_priori[k][i] = log(0.5);
+        }
+    }
+    int *decoded = convcode_extrinsic(received, encoded_length, &a_priori, code, sigma*sigma, 1);
+    for (int j = 0; j < packet_length; ++j)
+        errors += (decoded[j] != packet[j]);
+
+    free(decoded);
+    free(encoded);
+    free(received);
+    return errors;/*}}}*/
+}
+
+int simulate_turbo(int *packet, double *noise_sequence, int packet_length, double sigma, t_turbocode *code, int iterations,
+                   int *puncturing_pattern)
+{
+    int errors = 0;/*{{{*/
+    int *encoded = turbo_encode(packet, code);
+    int encoded_length = code->encoded_length;
+
+    double *received = malloc(encoded_length * sizeof *received);
+    for (int i = 0; i < encoded_length; i++) {
+        double r = (2 * encoded[i] - 1) + sigma * noise_sequence[i];
+        double kkk = (puncturing_pattern) ? puncturing_pattern[i] * r : r;
+        received[i] = kkk;
+    }
+
+    int *decoded = turbo_decode(received, iterations, sigma*sigma, code);
+    for (int j = 0; j < packet_length; ++j)
+        errors += (decoded[j] != packet[j]);
+
+    free(decoded);
+    free(encoded);
+    free(received);
+    return errors;/*}}}*/
+}
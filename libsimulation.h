@@ -0,0 +1,200 @@
+#ifndef DEEPSPACE_TURBO_LIBSIMULATION_H
+#define DEEPSPACE_TURBO_LIBSIMULATION_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <omp.h>
+#include <pthread.h>
+#include "libconvcodes.h"
+#include "libturbocodes.h"
+
+// counters of a single SNR point
+typedef struct str_simpoint{
+    double EbN0_dB;
+    double sigma;
+    long int errors;
+    long int errors_squared;
+    long int erroneous_packets;
+    long int processed_packets;
+
+    // monotonic pruning: packets credited without decoding, spot-checked
+    // packets and spot-checks that failed after a success at a lower SNR
+    long int pruned_packets;
+    long int checked_packets;
+    long int violations;
+
+    int retired;
+} t_simpoint;
+
+// BER/PER estimates with their confidence intervals
+typedef struct str_estimate{
+    double BER;
+    double BER_low;
+    double BER_high;
+    double PER;
+    double PER_low;
+    double PER_high;
+} t_estimate;
+
+// unit of work: a batch of packets, simulated at every SNR point that is
+// still active when the packet is processed
+typedef struct str_task{
+    int batch;
+    int first_packet;
+    int count;
+} t_task;
+
+// single-output encoder shared by every configuration that uses it
+typedef struct str_simcomponent{
+    t_convcode *code;
+    int group;
+    int lower;          // fed with the interleaved packet
+} t_simcomponent;
+
+// configurations with the same packet length and interleaver
+typedef struct str_simgroup{
+    int packet_length;
+    int *interleaver;
+} t_simgroup;
+
+// a turbo code evaluated on its own SNR grid
+typedef struct str_simconfig{
+    char *name;
+    t_turbocode *code;
+    int *puncturing_pattern;
+    double rate;
+    int iterations;
+
+    // stopping rules, initialized from the simulation when the configuration is added
+    int num_packets;
+    long int min_errors;
+    double precision;
+
+    int group;
+    int *components;    // outputs of the upper code, then of the lower code
+
+    // identity of the CCSDS code, used as a key by the results store
+    int code_type;
+    int octets;
+
+    int SNR_points;
+    t_simpoint *points;
+    t_simpoint *prior;  // counters of earlier runs, only used by the stopping rules and the estimates
+} t_simconfig;
+
+// per-worker buffers, allocated once for the whole run
+typedef struct str_workspace{
+    int packet_length;  // longest packet among the configurations
+    int encoded_length; // longest codeword among the configurations
+    int *packet;
+    int **interleaved;  // one per group
+    int **streams;      // one per component
+    int *encoded;
+    double *noise;      // unit-variance noise shared by all configurations
+    double *received;   // one received signal per active SNR point
+    int *active;        // indices of the active SNR points
+    t_simpoint **deltas;// counters of the current packet, one array per configuration
+    int worker;         // index of the commit sequence of this worker
+} t_workspace;
+
+// double-ended queue owned by a worker: the owner pops from the head,
+// idle workers steal from the tail
+typedef struct str_taskqueue{
+    t_task *tasks;
+    int head;
+    int tail;
+    omp_lock_t lock;
+} t_taskqueue;
+
+typedef struct str_simulation{
+    // stopping rules: a point is retired once it has seen min_errors erroneous
+    // packets and both confidence intervals are within the target relative
+    // precision, or when num_packets packets (the compute budget) were simulated.
+    // Configurations may override them; num_packets must then be the largest budget
+    int num_packets;
+    long int min_errors;
+    double precision;
+    double confidence;
+
+    // when prune is set, a packet decoded correctly at some SNR point is
+    // credited as error-free at all higher points; a fraction prune_check of
+    // the packets is decoded anyway to validate the assumption
+    int prune;
+    double prune_check;
+
+    int batch_size;
+    int threads;
+    uint64_t seed;
+
+    // sharded runs: this process simulates the batches b with b % shards == shard.
+    // Packet k always draws from stream k of the seed, so shards with the same
+    // seed and packet count partition the packets of one big run
+    int shard;
+    int shards;
+    long int shard_packets;
+
+    // progress: workers bump completed_packets, a reporter thread prints a
+    // summary every progress_interval seconds (0 disables it) and, if
+    // status_file is set, rewrites the same summary there
+    long int completed_packets;
+    double progress_interval;
+    char *status_file;
+
+    // checkpointing: packets are added to the counters with atomic updates,
+    // and batch_done counts the packets committed from the start of each
+    // batch. Together with the seed this is the position of every RNG stream,
+    // so a checkpoint can be resumed exactly. The commit sequence of a worker
+    // is odd while it commits a packet: the checkpoint writer copies the
+    // counters again until no commit overlapped the copy
+    int batches;
+    int *batch_done;
+    int workers;
+    unsigned long *commit_sequence; // one per worker, a cache line apart
+    pthread_mutex_t lock;           // taken by the checkpoint writers only
+    char *checkpoint_file;
+    double checkpoint_interval;
+    int interrupted;
+
+    // all configurations see the same packets and noise realizations
+    int configs_count;
+    t_simconfig *configs;
+    int groups_count;
+    t_simgroup *groups;
+    int components_count;
+    t_simcomponent *components;
+} t_simulation;
+
+// decoder throughput and latency under a sustained load
+typedef struct str_throughput{
+    long int frames;
+    double seconds;
+    double info_mbps;
+    double frames_per_second;
+    double latency_p50;     // seconds
+    double latency_p99;
+    double latency_p999;
+    double iterations;      // per frame
+} t_throughput;
+
+t_simulation *simulation_initialize(void);
+int simulation_add_config(t_simulation *sim, char *name, t_turbocode *code, int *puncturing_pattern, double rate,
+                          int iterations, double *EbN0_dB, int SNR_points);
+void simulation_run(t_simulation *sim);
+int simulation_retire(t_simulation *sim);
+int simulation_save_checkpoint(t_simulation *sim, char *filename);
+int simulation_load_checkpoint(t_simulation *sim, char *filename);
+void simulation_save_counts(t_simulation *sim, FILE *file);
+t_estimate simulation_estimate(t_simpoint *point, int info_length, double confidence);
+void simulation_total(t_simconfig *config, int s, t_simpoint *total);
+void simulation_report(t_simulation *sim, FILE *file, double elapsed);
+void simulation_clear(t_simulation *sim);
+t_throughput simulation_throughput(t_simconfig *config, double EbN0_dB, int frames, double duration, int threads,
+                                   uint64_t seed);
+
+// thread routines
+int simulate_awgn(int *packet, double *noise_sequence, int packet_length, double sigma);
+int simulate_conv(int *packet, double *noise_sequence, int packet_length, double sigma, t_convcode *code);
+int simulate_turbo(int *packet, double *noise_sequence, int packet_length, double sigma, t_turbocode *code, int iterations,
+                   int *puncturing_pattern);
+
+#endif //DEEPSPACE_TURBO_LIBSIMULATION_H
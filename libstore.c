@@ -0,0 +1,159 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "libstore.h"
+
+// constituent decoder and precision. Radix and schedule give the same
+// results, they are not part of the key
+static char *store_decoder(t_simconfig *config)
+{
+    if (config->code->upper_code->decoder == SISO_PROBABILITY)
+        return "probability";
+
+    if (config->code->upper_code->decoder == SISO_SOVA)
+        return "sova";
+
+    return config->code->single_precision ? "log-map-float" : "log-map";
+}
+
+#define STORE_HEADER "code,k,packet_length,iterations,decoder,EbN0,processed_packets,erroneous_packets,errors," \
+                     "errors_squared,pruned_packets,checked_packets,violations,seed,shard,shards,time\n"
+
+// a line of the store
+typedef struct str_storerow{
+    int code_type;
+    int octets;
+    int packet_length;
+    int iterations;
+    char decoder[32];
+    t_simpoint point;
+    unsigned long long seed;
+    int shard;
+    int shards;
+} t_storerow;
+
+static int store_parse(char *line, t_storerow *row)
+{
+    t_simpoint *p = &row->point;/*{{{*/
+    return sscanf(line, "%d,%d,%d,%d,%31[^,],%lf,%ld,%ld,%ld,%ld,%ld,%ld,%ld,%llu,%d,%d", &row->code_type,
+                  &row->octets, &row->packet_length, &row->iterations, row->decoder, &p->EbN0_dB,
+                  &p->processed_packets, &p->erroneous_packets, &p->errors, &p->errors_squared, &p->pruned_packets,
+                  &p->checked_packets, &p->violations, &row->seed, &row->shard, &row->shards) == 16;/*}}}*/
+}
+
+// add the counters of every stored run to the priors of the matching points.
+// Returns the number of matching lines, 0 if the store does not exist yet and
+// -1 if it is malformed
+int store_load(t_simulation *sim, char *filename)
+{
+    FILE *file = fopen(filename, "r");/*{{{*/
+    if (!file)
+        return 0;
+
+    char line[1024];
+    int matched = 0;
+
+    while (fgets(line, sizeof(line), file)) {
+        // header lines may be repeated when stores are concatenated
+        if (!strncmp(line, "code,", 5))
+            continue;
+
+        t_storerow row;
+        if (!store_parse(line, &row)) {
+            fclose(file);
+            return -1;
+        }
+
+        for (int c = 0; c < sim->configs_count; c++) {
+            t_simconfig *config = &sim->configs[c];
+            if (config->code_type != row.code_type || config->octets != row.octets ||
+                config->code->packet_length != row.packet_length || config->iterations != row.iterations ||
+                strcmp(row.decoder, store_decoder(config)))
+                continue;
+
+            for (int s = 0; s < config->SNR_points; s++) {
+                if (fabs(config->points[s].EbN0_dB - row.point.EbN0_dB) > 1e-9)
+                    continue;
+
+                t_simpoint *prior = &config->prior[s];
+                prior->processed_packets += row.point.processed_packets;
+                prior->erroneous_packets += row.point.erroneous_packets;
+                prior->errors += row.point.errors;
+                prior->errors_squared += row.point.errors_squared;
+                prior->pruned_packets += row.point.pruned_packets;
+                prior->checked_packets += row.point.checked_packets;
+                prior->violations += row.point.violations;
+                matched++;
+            }
+        }
+    }
+
+    fclose(file);
+    return matched;/*}}}*/
+}
+
+// a run can only be added if its packets are not in the store already: same
+// seed is fine only for other shards of the same partition
+int store_seed_used(char *filename, uint64_t seed, int shard, int shards)
+{
+    FILE *file = fopen(filename, "r");/*{{{*/
+    if (!file)
+        return 0;
+
+    char line[1024];
+    int used = 0;
+    while (!used && fgets(line, sizeof(line), file)) {
+        t_storerow row;
+        if (strncmp(line, "code,", 5) && store_parse(line, &row))
+            used = row.seed == seed && (row.shards != shards || row.shard == shard);
+    }
+
+    fclose(file);
+    return used;/*}}}*/
+}
+
+// append the counters of this run with a single write, so that concurrent
+// shards appending to the same store do not interleave their lines
+int store_append(t_simulation *sim, char *filename)
+{
+    size_t size = 0;/*{{{*/
+    char *buffer = NULL;
+    FILE *lines = open_memstream(&buffer, &size);
+    if (!lines)
+        return -1;
+
+    long int now = (long int) time(NULL);
+    for (int c = 0; c < sim->configs_count; c++) {
+        t_simconfig *config = &sim->configs[c];
+        for (int s = 0; s < config->SNR_points; s++) {
+            t_simpoint *p = &config->points[s];
+            if (!p->processed_packets)
+                continue;
+
+            fprintf(lines, "%d,%d,%d,%d,%s,%.17g,%ld,%ld,%ld,%ld,%ld,%ld,%ld,%llu,%d,%d,%ld\n", config->code_type,
+                    config->octets, config->code->packet_length, config->iterations, store_decoder(config), p->EbN0_dB,
+                    p->processed_packets, p->erroneous_packets, p->errors, p->errors_squared, p->pruned_packets,
+                    p->checked_packets, p->violations, (unsigned long long) sim->seed, sim->shard, sim->shards, now);
+        }
+    }
+    fclose(lines);
+
+    int fd = open(filename, O_WRONLY | O_APPEND | O_CREAT, 0644);
+    if (fd < 0) {
+        free(buffer);
+        return -1;
+    }
+
+    // a new store starts with the header
+    int failed = lseek(fd, 0, SEEK_END) == 0 && write(fd, STORE_HEADER, strlen(STORE_HEADER)) < 0;
+    failed = failed || (size && write(fd, buffer, size) != (ssize_t) size);
+    failed = fsync(fd) || failed;
+    failed = close(fd) || failed;
+
+    free(buffer);
+    return failed ? -1 : 0;/*}}}*/
+}
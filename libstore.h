@@ -0,0 +1,14 @@
+#ifndef DEEPSPACE_TURBO_LIBSTORE_H
+#define DEEPSPACE_TURBO_LIBSTORE_H
+
+#include <stdint.h>
+#include "libsimulation.h"
+
+// append-only results store: every completed run adds one line per SNR point
+// with its raw counters, keyed by code, multiplier, packet length, iterations,
+// decoder and Eb/N0. Stores can be concatenated to merge them
+int store_load(t_simulation *sim, char *filename);
+int store_seed_used(char *filename, uint64_t seed, int shard, int shards);
+int store_append(t_simulation *sim, char *filename);
+
+#endif //DEEPSPACE_TURBO_LIBSTORE_H
@@ -0,0 +1,222 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include "libsweep.h"
+#include "utilities.h"
+
+#define MAX_LIST 16
+
+// lists of a section, expanded in every combination when the section ends
+typedef struct str_sweepsection{
+    char name[32];
+    int codes[MAX_LIST];
+    int codes_count;
+    int octets[MAX_LIST];
+    int octets_count;
+    int iterations[MAX_LIST];
+    int iterations_count;
+    t_sweepentry entry;     // scalar settings
+} t_sweepsection;
+
+t_sweep *sweep_initialize(void)
+{
+    t_sweep *sweep = malloc(sizeof *sweep);
+    sweep->entries_count = 0;
+    sweep->entries = NULL;
+    return sweep;
+}
+
+void sweep_add(t_sweep *sweep, t_sweepentry *entry)
+{
+    sweep->entries = realloc(sweep->entries, (sweep->entries_count + 1) * sizeof *sweep->entries);
+    sweep->entries[sweep->entries_count++] = *entry;
+}
+
+void sweep_clear(t_sweep *sweep)
+{
+    free(sweep->entries);
+    sweep->entries = NULL;
+    sweep->entries_count = 0;
+}
+
+static char *trim(char *str)
+{
+    while (isspace((unsigned char) *str))
+        str++;
+
+    char *end = str + strlen(str);
+    while (end > str && isspace((unsigned char) end[-1]))
+        *--end = '\0';
+
+    return str;
+}
+
+static void section_begin(t_sweepsection *section, char *name, t_sweepentry *defaults)
+{
+    strncpy(section->name, name, sizeof(section->name) - 1);/*{{{*/
+    section->name[sizeof(section->name) - 1] = '\0';
+
+    // names end up in file names and in comma-separated outputs
+    for (char *c = section->name; *c; c++)
+        if (isspace((unsigned char) *c) || *c == ',' || *c == '/')
+            *c = '_';
+
+    section->entry = *defaults;
+    section->codes[0] = defaults->code_type;
+    section->codes_count = 1;
+    section->octets[0] = defaults->octets;
+    section->octets_count = 1;
+    section->iterations[0] = defaults->iterations;
+    section->iterations_count = 1;/*}}}*/
+}
+
+// add every combination of the lists of a section, return 0 if a list is
+// empty or a value is out of range
+static int section_end(t_sweep *sweep, t_sweepsection *section)
+{
+    t_sweepentry entry = section->entry;/*{{{*/
+    if (entry.min_SNR >= entry.max_SNR || entry.SNR_points <= 0 || entry.num_packets <= 0 || entry.precision <= 0)
+        return 0;
+
+    // an empty list would drop the section without a word
+    if (section->codes_count <= 0 || section->octets_count <= 0 || section->iterations_count <= 0)
+        return 0;
+
+    for (int t = 0; t < section->codes_count; t++) {
+        for (int o = 0; o < section->octets_count; o++) {
+            for (int i = 0; i < section->iterations_count; i++) {
+                entry.code_type = section->codes[t];
+                entry.octets = section->octets[o];
+                entry.iterations = section->iterations[i];
+                if (entry.code_type < 1 || entry.code_type > 4 || entry.octets <= 0 || entry.iterations <= 0)
+                    return 0;
+
+                snprintf(entry.name, sizeof(entry.name), "%s_code%d_k%d_i%d", section->name, entry.code_type,
+                         entry.octets, entry.iterations);
+
+                // names identify the configurations in checkpoints and counters
+                for (int n = 0; n < sweep->entries_count; n++)
+                    if (!strcmp(sweep->entries[n].name, entry.name))
+                        return 0;
+
+                sweep_add(sweep, &entry);
+            }
+        }
+    }
+
+    return 1;/*}}}*/
+}
+
+// set a key of a section, return 0 if it is unknown
+static int section_set(t_sweepsection *section, char *key, char *value)
+{
+    t_sweepentry *entry = &section->entry;/*{{{*/
+
+    if (!strcmp(key, "code"))
+        section->codes_count = parse_list(value, section->codes, MAX_LIST);
+    else if (!strcmp(key, "multiplier"))
+        section->octets_count = parse_list(value, section->octets, MAX_LIST);
+    else if (!strcmp(key, "iterations"))
+        section->iterations_count = parse_list(value, section->iterations, MAX_LIST);
+    else if (!strcmp(key, "min-SNR"))
+        entry->min_SNR = strtod(value, NULL);
+    else if (!strcmp(key, "max-SNR"))
+        entry->max_SNR = strtod(value, NULL);
+    else if (!strcmp(key, "SNR-points"))
+        entry->SNR_points = (int) strtol(value, NULL, 10);
+    else if (!strcmp(key, "packet-count"))
+        entry->num_packets = (int) strtod(value, NULL);
+    else if (!strcmp(key, "min-errors"))
+        entry->min_errors = (long int) strtod(value, NULL);
+    else if (!strcmp(key, "precision"))
+        entry->precision = strtod(value, NULL);
+    else
+        return 0;
+
+    return 1;/*}}}*/
+}
+
+// read a sweep description:
+//
+//   # settings before the first section, or in [defaults], apply to the sections that follow
+//   packet-count = 1e5
+//   [iterations]
+//   code = 1
+//   multiplier = 1
+//   iterations = 1,2,3
+//   min-SNR = 0.5
+//   max-SNR = 3
+//
+// every section adds one configuration per combination of code, multiplier
+// and iterations. Returns 0, -1 if the file can't be read or the number of
+// the offending line
+int sweep_load(t_sweep *sweep, char *filename, t_sweepentry *defaults)
+{
+    FILE *file = fopen(filename, "r");/*{{{*/
+    if (!file)
+        return -1;
+
+    t_sweepentry global = *defaults;
+    t_sweepsection section;
+    int in_section = 0;
+    int line_number = 0;
+    int error = 0;
+    char buffer[1024];
+
+    while (!error && fgets(buffer, sizeof(buffer), file)) {
+        line_number++;
+        char *comment = strpbrk(buffer, "#;");
+        if (comment)
+            *comment = '\0';
+
+        char *line = trim(buffer);
+        if (!*line)
+            continue;
+
+        if (*line == '[') {
+            char *close = strchr(line, ']');
+            if (!close || (in_section && !section_end(sweep, &section))) {
+                error = line_number;
+                break;
+            }
+            *close = '\0';
+
+            // the defaults section only changes the settings of the following sections
+            in_section = strcmp(trim(line + 1), "defaults") != 0;
+            if (in_section)
+                section_begin(&section, trim(line + 1), &global);
+            continue;
+        }
+
+        char *value = strchr(line, '=');
+        if (!value) {
+            error = line_number;
+            break;
+        }
+        *value++ = '\0';
+        char *key = trim(line);
+        value = trim(value);
+
+        if (in_section) {
+            error = section_set(&section, key, value) ? 0 : line_number;
+        } else {
+            // defaults hold a single code, multiplier and iteration count
+            t_sweepsection scratch;
+            section_begin(&scratch, "", &global);
+            int known = section_set(&scratch, key, value);
+            int empty = scratch.codes_count <= 0 || scratch.octets_count <= 0 || scratch.iterations_count <= 0;
+            error = known && !empty ? 0 : line_number;
+            global = scratch.entry;
+            global.code_type = scratch.codes[0];
+            global.octets = scratch.octets[0];
+            global.iterations = scratch.iterations[0];
+        }
+    }
+
+    if (!error && in_section && !section_end(sweep, &section))
+        error = line_number;
+
+    fclose(file);
+    return error;/*}}}*/
+}
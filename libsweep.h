@@ -0,0 +1,28 @@
+#ifndef DEEPSPACE_TURBO_LIBSWEEP_H
+#define DEEPSPACE_TURBO_LIBSWEEP_H
+
+// a CCSDS code simulated on its own SNR grid with its own stopping rules
+typedef struct str_sweepentry{
+    char name[96];
+    int code_type;
+    int octets;
+    int iterations;
+    double min_SNR;
+    double max_SNR;
+    int SNR_points;
+    int num_packets;
+    long int min_errors;
+    double precision;
+} t_sweepentry;
+
+typedef struct str_sweep{
+    int entries_count;
+    t_sweepentry *entries;
+} t_sweep;
+
+t_sweep *sweep_initialize(void);
+void sweep_add(t_sweep *sweep, t_sweepentry *entry);
+int sweep_load(t_sweep *sweep, char *filename, t_sweepentry *defaults);
+void sweep_clear(t_sweep *sweep);
+
+#endif //DEEPSPACE_TURBO_LIBSWEEP_H
@@ -4,46 +4,58 @@
 
 #include "libturbocodes.h"
 #include "utilities.h"
+#include "profiling.h"
+#include "perfcounters.h"
 #include <stdlib.h>
 #include <math.h>
 
 
 int *turbo_interleave(int *packet, t_turbocode *code)
 {
+    PROFILE_BEGIN(PROFILE_INTERLEAVE);
+    PERF_KERNEL_BEGIN(PERF_KERNEL_INTERLEAVE);
     int *interleaved_packet = malloc(code->packet_length * sizeof(int));// {{{
-    for (int j = 0; j < code->packet_length; ++j) {
-        interleaved_packet[j] = packet[code->interleaver[j]];
-    }
+    interleaver_apply_bits(code->pi, interleaved_packet, packet, INTERLEAVE);
+    PERF_KERNEL_END(PERF_KERNEL_INTERLEAVE, 0, code->packet_length);
+    PROFILE_END(PROFILE_INTERLEAVE);
 
     return interleaved_packet;// }}}
 }
 
 int *turbo_deinterleave(int *packet, t_turbocode *code)
 {
+    PROFILE_BEGIN(PROFILE_DEINTERLEAVE);
+    PERF_KERNEL_BEGIN(PERF_KERNEL_DEINTERLEAVE);
     int *local = malloc(code->packet_length*sizeof(int));// {{{
-    for (int i = 0; i < code->packet_length; ++i) {
-        local[code->interleaver[i]] = packet[i];
-    }
+    interleaver_apply_bits(code->pi, local, packet, DEINTERLEAVE);
+    PERF_KERNEL_END(PERF_KERNEL_DEINTERLEAVE, 0, code->packet_length);
+    PROFILE_END(PROFILE_DEINTERLEAVE);
 
     return local;// }}}
 }
 
+// gather the messages into scratch, then swap the rows: scratch gets the old ones
+static void messages_permute(double **messages, double **scratch, t_turbocode *code, int direction)
+{
+    interleaver_apply_pair(code->pi, scratch, messages, direction);
+    for (int i = 0; i < 2; i++) {
+        double *row = messages[i];
+        messages[i] = scratch[i];
+        scratch[i] = row;
+    }
+}
+
 void message_interleave(double ***messages, t_turbocode *code)
 {
-    // local array// {{{
     double *local[2];
     local[0] = malloc(code->packet_length * sizeof(double));
     local[1] = malloc(code->packet_length * sizeof(double));
 
-    for (int i = 0; i < code->packet_length; ++i) {
-        local[0][i] = (*messages)[0][code->interleaver[i]];
-        local[1][i] = (*messages)[1][code->interleaver[i]];
-    }
-
-    for (int i = 0; i < code->packet_length; ++i) {
-        (*messages)[0][i] = local[0][i];
-        (*messages)[1][i] = local[1][i];
-    }
+    PROFILE_BEGIN(PROFILE_INTERLEAVE);
+    PERF_KERNEL_BEGIN(PERF_KERNEL_INTERLEAVE);
+    messages_permute(*messages, local, code, INTERLEAVE);
+    PERF_KERNEL_END(PERF_KERNEL_INTERLEAVE, 0, code->packet_length);
+    PROFILE_END(PROFILE_INTERLEAVE);
 
     free(local[0]);
     free(local[1]);
@@ -51,20 +63,15 @@ void message_interleave(double ***messages, t_turbocode *code)
 
 void message_deinterleave(double ***messages, t_turbocode *code)
 {
-     // local array
     double *local[2];
     local[0] = malloc(code->packet_length * sizeof(double));
     local[1] = malloc(code->packet_length * sizeof(double));
 
-    for (int i = 0; i < code->packet_length; ++i) {
-        local[0][code->interleaver[i]] = (*messages)[0][i];
-        local[1][code->interleaver[i]] = (*messages)[1][i];
-    }
-
-    for (int i = 0; i < code->packet_length; ++i) {
-        (*messages)[0][i] = local[0][i];
-        (*messages)[1][i] = local[1][i];
-    }
+    PROFILE_BEGIN(PROFILE_DEINTERLEAVE);
+    PERF_KERNEL_BEGIN(PERF_KERNEL_DEINTERLEAVE);
+    messages_permute(*messages, local, code, DEINTERLEAVE);
+    PERF_KERNEL_END(PERF_KERNEL_DEINTERLEAVE, 0, code->packet_length);
+    PROFILE_END(PROFILE_DEINTERLEAVE);
 
     free(local[0]);
     free(local[1]);
@@ -80,19 +87,49 @@ t_turbocode *turbo_initialize(t_convcode *upper, t_convcode *lower, int *interle
     code->packet_length = packet_length;
     code->interleaver = interleaver;
 
+    // deinterleaving gathers through the inverse permutation
+    code->pi = interleaver_initialize(interleaver, packet_length);
+    if (!code->pi) {
+        free(code);
+        return NULL;
+    }
+
     // compute encoded length
     int turbo_length = 0;
     turbo_length += upper->components * (code->packet_length + upper->memory);
     turbo_length += lower->components * (code->packet_length + lower->memory);
 
     code->encoded_length = turbo_length;
+    code->single_precision = 0;
 
     return code;/*}}}*/
 }
 
+// decode on floats (1) or doubles (0, the default). Floats halve the memory
+// traffic of the decoder at a negligible cost in BER
+void turbo_set_single_precision(t_turbocode *code, int single)
+{
+    code->single_precision = single != 0;
+}
+
+// apply every decoder setting to both codes. Returns -1 if one is invalid
+int turbo_set_options(t_turbocode *code, t_turbooptions *options)
+{
+    t_convcode *codes[2] = {code->upper_code, code->lower_code};/*{{{*/
+    for (int i = 0; i < 2; i++)
+        if (convcode_set_radix(codes[i], options->radix) || convcode_set_schedule(codes[i], options->schedule) ||
+            convcode_set_decoder(codes[i], options->decoder) ||
+            convcode_set_sova_window(codes[i], options->sova_window))
+            return -1;
+
+    turbo_set_single_precision(code, options->single_precision);
+    return 0;/*}}}*/
+}
+
 int *turbo_encode(int *packet, t_turbocode *code)
 {
     int *interleaved_packet = turbo_interleave(packet, code);/*{{{*/
+    PROFILE_BEGIN(PROFILE_ENCODE);
 
     // reference to encoded messages
     int **conv_encoded = malloc(2 * sizeof(int*));
@@ -128,13 +165,88 @@ int *turbo_encode(int *packet, t_turbocode *code)
     free(conv_encoded);
 
     free(interleaved_packet);
+    PROFILE_END(PROFILE_ENCODE);
 
     return turbo_encoded;/*}}}*/
 }
 
+// turbo_decode on floats: the received samples are converted while they are
+// split between the two codes
+static int *turbo_decode_float(double *received, int iterations, double noise_variance, t_turbocode *code)
+{
+    // serial to parallel/*{{{*/
+    PROFILE_BEGIN(PROFILE_SERIAL_TO_PARALLEL);
+    int lengths[2];
+    float *streams[2];
+    t_convcode *codes[2] = {code->upper_code, code->lower_code};
+    for (int i = 0; i < 2; i++) {
+        lengths[i] = codes[i]->components * (code->packet_length + codes[i]->memory);
+        streams[i] = malloc(lengths[i] * sizeof *streams[i]);
+    }
+
+    int k = 0, c = 0, cw = 0;
+    while (k < code->encoded_length) {
+        t_convcode *cc = codes[c];
+
+        for (int i = 0; i < cc->components; i++)
+            streams[c][cw*cc->components + i] = (float) received[k++];
+
+        c = (c + 1) % 2;
+        cw = !c ? cw + 1 : cw;
+    }
+    PROFILE_END(PROFILE_SERIAL_TO_PARALLEL);
+
+    // the lower code works on the interleaved rows in scratch
+    float **messages = malloc(2 * sizeof *messages);
+    float **scratch = malloc(2 * sizeof *scratch);
+    for (int i = 0; i < 2; i++) {
+        scratch[i] = malloc(code->packet_length * sizeof *scratch[i]);
+        messages[i] = malloc(code->packet_length * sizeof *messages[i]);
+        for (int j = 0; j < code->packet_length; j++)
+            messages[i][j] = logf(0.5f);
+    }
+
+    int *turbo_decoded = NULL;
+    for (int i = 0; i < iterations; i++) {
+        convcode_extrinsic_float(streams[0], lengths[0], &messages, code->upper_code, (float) noise_variance, 0);
+
+        PROFILE_BEGIN(PROFILE_INTERLEAVE);
+        PERF_KERNEL_BEGIN(PERF_KERNEL_INTERLEAVE);
+        interleaver_apply_pair_float(code->pi, scratch, messages, INTERLEAVE);
+        PERF_KERNEL_END(PERF_KERNEL_INTERLEAVE, 0, code->packet_length);
+        PROFILE_END(PROFILE_INTERLEAVE);
+
+        turbo_decoded = convcode_extrinsic_float(streams[1], lengths[1], &scratch, code->lower_code,
+                                                 (float) noise_variance, i == (iterations - 1));
+
+        PROFILE_BEGIN(PROFILE_DEINTERLEAVE);
+        PERF_KERNEL_BEGIN(PERF_KERNEL_DEINTERLEAVE);
+        interleaver_apply_pair_float(code->pi, messages, scratch, DEINTERLEAVE);
+        PERF_KERNEL_END(PERF_KERNEL_DEINTERLEAVE, 0, code->packet_length);
+        PROFILE_END(PROFILE_DEINTERLEAVE);
+    }
+
+    int *decoded_deinterleaved = turbo_deinterleave(turbo_decoded, code);
+    free(turbo_decoded);
+
+    for (int i = 0; i < 2; i++) {
+        free(messages[i]);
+        free(scratch[i]);
+        free(streams[i]);
+    }
+    free(messages);
+    free(scratch);
+
+    return decoded_deinterleaved;/*}}}*/
+}
+
 int *turbo_decode(double *received, int iterations, double noise_variance, t_turbocode *code)
 {
+    if (code->single_precision)
+        return turbo_decode_float(received, iterations, noise_variance, code);
+
     // serial to parallel/*{{{*/
+    PROFILE_BEGIN(PROFILE_SERIAL_TO_PARALLEL);
     int lengths[2]; // = malloc(2 * sizeof  *lengths);/*{{{*/
     double *streams[2];
     t_convcode *codes[2] = {code->upper_code, code->lower_code};
@@ -154,10 +266,13 @@ int *turbo_decode(double *received, int iterations, double noise_variance, t_tur
         c = (c + 1) % 2;
         cw = !c ? cw + 1 : cw;
     }/*}}}*/
+    PROFILE_END(PROFILE_SERIAL_TO_PARALLEL);
 
-    // initial messages
+    // initial messages, permuted back and forth through the scratch rows
     double **messages = malloc(2 * sizeof *messages);
+    double *scratch[2];
     for (int i = 0; i < 2; i++) {
+        scratch[i] = malloc(code->packet_length * sizeof(double));
         messages[i] = malloc(code->packet_length * sizeof(double));
         for (int j = 0; j < code->packet_length; j++) {
             messages[i][j] = log(0.5);
@@ -171,13 +286,21 @@ int *turbo_decode(double *received, int iterations, double noise_variance, t_tur
         convcode_extrinsic(streams[0], lengths[0], &messages, code->upper_code, noise_variance, 0);
 
         // apply interleaver
-        message_interleave(&messages, code);
+        PROFILE_BEGIN(PROFILE_INTERLEAVE);
+        PERF_KERNEL_BEGIN(PERF_KERNEL_INTERLEAVE);
+        messages_permute(messages, scratch, code, INTERLEAVE);
+        PERF_KERNEL_END(PERF_KERNEL_INTERLEAVE, 0, code->packet_length);
+        PROFILE_END(PROFILE_INTERLEAVE);
 
         // run BCJR on lower code
         turbo_decoded = convcode_extrinsic(streams[1], lengths[1], &messages, code->lower_code, noise_variance, i == (iterations - 1));
 
         // deinterleave
-        message_deinterleave(&messages, code);
+        PROFILE_BEGIN(PROFILE_DEINTERLEAVE);
+        PERF_KERNEL_BEGIN(PERF_KERNEL_DEINTERLEAVE);
+        messages_permute(messages, scratch, code, DEINTERLEAVE);
+        PERF_KERNEL_END(PERF_KERNEL_DEINTERLEAVE, 0, code->packet_length);
+        PROFILE_END(PROFILE_DEINTERLEAVE);
     }
 
     int *decoded_deinterleaved = turbo_deinterleave(turbo_decoded, code);
@@ -187,6 +310,8 @@ int *turbo_decode(double *received, int iterations, double noise_variance, t_tur
     free(messages[0]);
     free(messages[1]);
     free(messages);
+    free(scratch[0]);
+    free(scratch[1]);
     free(streams[0]);
     free(streams[1]);
 
@@ -197,4 +322,6 @@ int *turbo_decode(double *received, int iterations, double noise_variance, t_tur
 void *turbocode_clear(t_turbocode *code)
 {
     free(code->interleaver);
+    interleaver_clear(code->pi);
+    free(code->pi);
 }
\ No newline at end of file
@@ -6,16 +6,30 @@
 #define DEEPSPACE_TURBO_LIBTURBOCODES_H
 
 #include "libconvcodes.h"
+#include "libinterleaver.h"
 
 typedef struct str_turbocode{
     t_convcode *upper_code;
     t_convcode *lower_code;
 
     int *interleaver;
+    t_interleaver *pi;      // the interleaver and its inverse
     int packet_length;
     int encoded_length;
+    int single_precision;   // decode on floats, see turbo_set_single_precision
 } t_turbocode;
 
+// decoder settings of both constituent codes and of the turbo decoder
+typedef struct str_turbooptions{
+    int radix;
+    t_bcjr_schedule schedule;
+    t_siso_decoder decoder;
+    int sova_window;
+    int single_precision;
+} t_turbooptions;
+
+#define TURBO_DEFAULT_OPTIONS {2, BCJR_SEQUENTIAL, SISO_LOG_MAP, SOVA_DEFAULT_WINDOW, 0}
+
 int *turbo_interleave(int *packet, t_turbocode *code);
 int *turbo_deinterleave(int *packet, t_turbocode *code);
 void message_interleave(double ***messages, t_turbocode *code);
@@ -24,6 +38,8 @@ t_turbocode *turbo_initialize(t_convcode *upper, t_convcode *lower, int *interle
 void *turbocode_clear(t_turbocode *code);
 
 int *turbo_encode(int *packet, t_turbocode *code);
+void turbo_set_single_precision(t_turbocode *code, int single);
+int turbo_set_options(t_turbocode *code, t_turbooptions *options);
 int *turbo_decode(double* received, int iterations, double noise_variance, t_turbocode *code);
 
 #endif //DEEPSPACE_TURBO_LIBTURBOCODES_H
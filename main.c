@@ -7,39 +7,209 @@
 #include <string.h>
 #include "libconvcodes.h"
 #include "libturbocodes.h"
+#include "libsimulation.h"
+#include "libccsds.h"
+#include "libsweep.h"
+#include "libstore.h"
+#include "profiling.h"
+#include "perfcounters.h"
+#include "cpudispatch.h"
 #include "utilities.h"
 #include <getopt.h>
 #include "colors.h"
 
-#define MAX_COMPONENTS 4
+#define MAX_CONFIGS 16
 
 
-// puncturing function: return 1 if bit k has to be punctured
-int puncturing(int k){
+// open the output of a configuration, named after it when more than one is simulated
+static FILE *open_config_file(t_simulation *sim, int n, char *filename)
+{
+    char config_filename[PATH_MAX];
+    strcpy(config_filename, filename);
+
+    if (sim->configs_count > 1) {
+        char *extension = strrchr(filename, '.');
+        int stem = extension ? (int)(extension - filename) : (int) strlen(filename);
+        snprintf(config_filename, sizeof(config_filename), "%.*s_%s%s", stem, filename, sim->configs[n].name,
+                 extension ? extension : "");
+    }
+
+    FILE *file = fopen(config_filename, "w");
+    if (!file){
+        perror("Something went wrong. Couldn't create output file");
+        exit(EXIT_FAILURE);
+    }
 
-    int bit_idx = k % 3;
+    return file;
+}
 
-    // bit 0,3,6,... corresponding to systematic output
-    if (!bit_idx)
-        return 1;
+// run the BER/PER sweep and save one file per configuration or, for sweep
+// files, a single table with one row per configuration and SNR point
+void run_sweep(t_simulation *sim, t_sweep *sweep, char *filename, double confidence, int prune_flag, int structured)
+{
+    // create output files before spending any time on the simulation
+    FILE **files = malloc(sim->configs_count * sizeof *files);
+    FILE *table = NULL;
+    if (structured) {
+        table = fopen(filename, "w");
+        if (!table){
+            perror("Something went wrong. Couldn't create output file");
+            exit(EXIT_FAILURE);
+        }
+        fprintf(table, "config,code,k,packet_length,iterations,EbN0,BER,PER,BER_low,BER_high,PER_low,PER_high,"
+                "packets,erroneous_packets,errors%s\n", prune_flag ? ",pruned,checked,violations" : "");
+    } else {
+        for (int n = 0; n < sim->configs_count; n++)
+            files[n] = open_config_file(sim, n, filename);
+    }
 
-    // get block index
-    int block_idx = k / 3;
+    // allocate memory to store results
+    int max_points = 0;
+    for (int n = 0; n < sim->configs_count; n++)
+        max_points = sim->configs[n].SNR_points > max_points ? sim->configs[n].SNR_points : max_points;
+
+    double *EbN0_dB = malloc(max_points*sizeof *EbN0_dB);
+    double *BER = malloc(max_points*sizeof *BER);
+    double *PER = malloc(max_points*sizeof *PER);
+    double *BER_low = malloc(max_points*sizeof *BER_low);
+    double *BER_high = malloc(max_points*sizeof *BER_high);
+    double *PER_low = malloc(max_points*sizeof *PER_low);
+    double *PER_high = malloc(max_points*sizeof *PER_high);
+    double *packets = malloc(max_points*sizeof *packets);
+    double *pruned = malloc(max_points*sizeof *pruned);
+    double *checked = malloc(max_points*sizeof *checked);
+    double *violations = malloc(max_points*sizeof *violations);
 
-    // on odd blocks puncture second bit
-    if (block_idx % 2){
-        return bit_idx != 1;
+    // simulation loop
+    simulation_run(sim);
+
+    // raw counters, so that runs and shards can be merged
+    char counts_filename[PATH_MAX];
+    snprintf(counts_filename, sizeof(counts_filename), "%s.counts.csv", filename);
+    FILE *counts = fopen(counts_filename, "w");
+    if (!counts){
+        perror("Something went wrong. Couldn't create counters file");
+        exit(EXIT_FAILURE);
     }
+    simulation_save_counts(sim, counts);
+    fclose(counts);
+
+    if (sim->interrupted)
+        printf(BOLDRED "\nSimulation interrupted, partial results follow. Continue with --resume.\n\n" RESET);
+    else
+        printf(BOLDGREEN "\nSimulation completed.\n\n" RESET);
+
+    for (int n = 0; n < sim->configs_count; n++) {
+        t_simconfig *config = &sim->configs[n];
+        int info_length = config->code->packet_length;
+        int SNR_points = config->SNR_points;
+
+        // compute BER and PER along with their confidence intervals, over
+        // this run and the earlier runs found in the results store
+        for (int i = 0; i < SNR_points; i++)
+        {
+            t_simpoint total;
+            simulation_total(config, i, &total);
+            t_estimate estimate = simulation_estimate(&total, info_length, confidence);
+            EbN0_dB[i] = config->points[i].EbN0_dB;
+            BER[i] = estimate.BER;
+            BER_low[i] = estimate.BER_low;
+            BER_high[i] = estimate.BER_high;
+            PER[i] = estimate.PER;
+            PER_low[i] = estimate.PER_low;
+            PER_high[i] = estimate.PER_high;
+            packets[i] = total.processed_packets;
+            pruned[i] = total.pruned_packets;
+            checked[i] = total.checked_packets;
+            violations[i] = total.violations;
+        }
 
-    // on even blocks puncture third bit
-    return bit_idx != 2;
+        // save results
+        if (structured) {
+            t_sweepentry *entry = &sweep->entries[n];
+            for (int i = 0; i < SNR_points; i++) {
+                fprintf(table, "%s,%d,%d,%d,%d,%.12g,%.12g,%.12g,%.12g,%.12g,%.12g,%.12g,%.0f,%ld,%ld", config->name,
+                        entry->code_type, entry->octets, info_length, config->iterations, EbN0_dB[i], BER[i], PER[i],
+                        BER_low[i], BER_high[i], PER_low[i], PER_high[i], packets[i],
+                        config->points[i].erroneous_packets + config->prior[i].erroneous_packets,
+                        config->points[i].errors + config->prior[i].errors);
+                if (prune_flag)
+                    fprintf(table, ",%.0f,%.0f,%.0f", pruned[i], checked[i], violations[i]);
+                fprintf(table, "\n");
+            }
+        } else {
+            char *headers[] = {"EbN0", "BER", "PER", "BER_low", "BER_high", "PER_low", "PER_high", "packets",
+                               "pruned", "checked", "violations"};
+            double *columns[] = {EbN0_dB, BER, PER, BER_low, BER_high, PER_low, PER_high, packets,
+                                 pruned, checked, violations};
+            save_table(columns, headers, prune_flag ? 11 : 8, SNR_points, files[n]);
+            fclose(files[n]);
+        }
+
+        // print results
+        if (sim->configs_count > 1)
+            printf(BOLDMAGENTA "\n%s\n" RESET, config->name);
+
+        printf(BOLDYELLOW "%20s%20s%28s%20s%28s%12s\n" RESET, "EbN0 [dB]", "BER", "BER interval", "PER",
+               "PER interval", "packets");
+        for (int j = 0; j < SNR_points; ++j)
+           printf("%20f%20.4e  [%.4e, %.4e]%20.4e  [%.4e, %.4e]%12.0f\n", EbN0_dB[j], BER[j], BER_low[j],
+                  BER_high[j], PER[j], PER_low[j], PER_high[j], packets[j]);
+
+        // report packets that failed at a higher SNR after a success at a lower one
+        if (prune_flag) {
+            printf(BOLDYELLOW "\n%20s%20s%20s%20s\n" RESET, "EbN0 [dB]", "pruned", "checked", "violations");
+            for (int j = 0; j < SNR_points; ++j)
+                printf("%20f%20.0f%20.0f%s%20.0f\n" RESET, EbN0_dB[j], pruned[j], checked[j],
+                       violations[j] ? BOLDRED : "", violations[j]);
+        }
+    }
+
+    if (table)
+        fclose(table);
+
+    free(files);
+    free(EbN0_dB);
+    free(BER);
+    free(PER);
+    free(BER_low);
+    free(BER_high);
+    free(PER_low);
+    free(PER_high);
+    free(packets);
+    free(pruned);
+    free(checked);
+    free(violations);
 }
 
-// thread routines
-int simulate_awgn(int *packet, double *noise_sequence, int packet_length, double sigma);
-int simulate_conv(int *packet, double *noise_sequence, int packet_length, double sigma, t_convcode *code);
-int simulate_turbo(int *packet, double *noise_sequence, int packet_length, double sigma, t_turbocode *code, int iterations,
-                   int *puncturing_pattern);
+// decode a stream of pre-generated frames for a fixed time with each configuration
+void run_throughput(t_simulation *sim, char *filename, double EbN0_dB, int frames, double duration, int threads)
+{
+    FILE *file = fopen(filename, "w");
+    if (!file){
+        perror("Something went wrong. Couldn't create output file");
+        exit(EXIT_FAILURE);
+    }
+
+    fprintf(file, "config,threads,EbN0,frames,seconds,info_mbps,frames_per_second,latency_p50_ms,latency_p99_ms,"
+            "latency_p999_ms,iterations\n");
+    printf(BOLDYELLOW "%-12s%10s%14s%14s%12s%12s%12s%12s\n" RESET, "config", "frames", "info Mbps", "frames/s",
+           "p50 [ms]", "p99 [ms]", "p99.9 [ms]", "iter/frame");
+
+    for (int n = 0; n < sim->configs_count; n++) {
+        t_simconfig *config = &sim->configs[n];
+        t_throughput result = simulation_throughput(config, EbN0_dB, frames, duration, threads, sim->seed);
+
+        fprintf(file, "%s,%d,%f,%ld,%f,%f,%f,%f,%f,%f,%f\n", config->name, threads, EbN0_dB, result.frames,
+                result.seconds, result.info_mbps, result.frames_per_second, 1e3*result.latency_p50,
+                1e3*result.latency_p99, 1e3*result.latency_p999, result.iterations);
+        printf("%-12s%10ld%14.4f%14.2f%12.3f%12.3f%12.3f%12.1f\n", config->name, result.frames, result.info_mbps,
+               result.frames_per_second, 1e3*result.latency_p50, 1e3*result.latency_p99, 1e3*result.latency_p999,
+               result.iterations);
+    }
+
+    fclose(file);
+}
 
 int main(int argc, char *argv[])
 {
@@ -52,18 +222,42 @@ int main(int argc, char *argv[])
     // default simulation parameters
     int packet_length = (int) 1e4;
     int num_packets = (int) 30;
-    int error_threshold = (int) 1e3;
+    int min_errors = 10;
+    double precision = 0.1;
+    double confidence = 0.95;
 
     int SNR_points = 8;
-    float min_SNR = -2;
-    float max_SNR = 2;
+    double min_SNR = -2;
+    double max_SNR = 2;
     int cores = 1;
+    int batch_size = 0;
+    int prune_flag = 0;
+    double prune_check = 0.05;
+    double throughput_seconds = 0;
+    double throughput_SNR = 1;
+    int throughput_frames = 64;
+    int perf_flag = 0;
+    double progress_interval = 10;
+    char status_filename[PATH_MAX] = "";
+    double checkpoint_interval = 600;
+    int resume_flag = 0;
+    int seed_flag = 0;
+    unsigned long long seed = 0;
+    int shard = 0;
+    int shards = 1;
+    char sweep_filename[PATH_MAX] = "";
+    char store_filename[PATH_MAX] = "";
+    char *interleaver_spec = NULL;
+    int radix = 2;
+    int single_precision_flag = 0;
+    t_siso_decoder decoder = SISO_LOG_MAP;
+    t_bcjr_schedule schedule = BCJR_SEQUENTIAL;
     int iterations = 2;
-    int octets = 1;
-    double rate = 1/2;
-    int *puncturing_pattern = NULL;
+    int octets[MAX_CONFIGS] = {1};
+    int octets_count = 1;
 
-    int code_type = 1;
+    int code_types[MAX_CONFIGS] = {1};
+    int codes_count = 1;
     char filename[PATH_MAX];
 
 
@@ -79,7 +273,30 @@ int main(int argc, char *argv[])
                         {"output",          required_argument,  0,  'o'},
                         {"packet-length",   required_argument,  0,  'l'},
                         {"packet-count",    required_argument,  0,  'c'},
+                        {"min-errors",      required_argument,  0,  'e'},
+                        {"precision",       required_argument,  0,  'p'},
+                        {"confidence",      required_argument,  0,  'z'},
                         {"cores",           required_argument,  0,  'C'},
+                        {"batch-size",      required_argument,  0,  'B'},
+                        {"prune",           no_argument,        0,  'P'},
+                        {"prune-check",     required_argument,  0,  'K'},
+                        {"throughput",      required_argument,  0,  'T'},
+                        {"throughput-SNR",  required_argument,  0,  'S'},
+                        {"frames",          required_argument,  0,  'F'},
+                        {"perf",            no_argument,        0,  'H'},
+                        {"progress",        required_argument,  0,  'I'},
+                        {"status-file",     required_argument,  0,  's'},
+                        {"checkpoint",      required_argument,  0,  'X'},
+                        {"resume",          no_argument,        0,  'r'},
+                        {"seed",            required_argument,  0,  'G'},
+                        {"shard",           required_argument,  0,  'Q'},
+                        {"sweep",           required_argument,  0,  'W'},
+                        {"store",           required_argument,  0,  'D'},
+                        {"interleaver",     required_argument,  0,  'J'},
+                        {"radix",           required_argument,  0,  'R'},
+                        {"schedule",        required_argument,  0,  'E'},
+                        {"float",           no_argument,        0,  'L'},
+                        {"decoder",         required_argument,  0,  'd'},
                         {"min-SNR",         required_argument,  0,  'm'},
                         {"max-SNR",         required_argument,  0,  'M'},
                         {"SNR-points",      required_argument,  0,  'n'},
@@ -92,7 +309,7 @@ int main(int argc, char *argv[])
 
         int option_index = 0;
 
-        c = getopt_long(argc, argv, "yhl:c:C:m:M:f:b:o:n:i:k:t:", long_options, &option_index);
+        c = getopt_long(argc, argv, "yhPHrLI:s:X:G:Q:W:D:J:R:E:d:l:c:e:p:z:C:B:K:T:S:F:m:M:f:b:o:n:i:k:t:", long_options, &option_index);
 
         if (c == -1)
             break;
@@ -112,10 +329,122 @@ int main(int argc, char *argv[])
                 num_packets = (int) strtof(optarg, NULL);
                 break;
 
+            case 'e':
+                min_errors = (int) strtof(optarg, NULL);
+                break;
+
+            case 'p':
+                precision = strtod(optarg, NULL);
+                break;
+
+            case 'z':
+                confidence = strtod(optarg, NULL);
+                break;
+
             case 'C':
                 cores = (int) strtof(optarg, NULL);
                 break;
 
+            case 'B':
+                batch_size = (int) strtof(optarg, NULL);
+                break;
+
+            case 'P':
+                prune_flag = 1;
+                break;
+
+            case 'K':
+                prune_check = strtod(optarg, NULL);
+                break;
+
+            case 'T':
+                throughput_seconds = strtod(optarg, NULL);
+                break;
+
+            case 'S':
+                throughput_SNR = strtod(optarg, NULL);
+                break;
+
+            case 'F':
+                throughput_frames = (int) strtof(optarg, NULL);
+                break;
+
+            case 'H':
+                perf_flag = 1;
+                break;
+
+            case 'I':
+                progress_interval = strtod(optarg, NULL);
+                break;
+
+            case 's':
+                strcpy(status_filename, optarg);
+                break;
+
+            case 'X':
+                checkpoint_interval = strtod(optarg, NULL);
+                break;
+
+            case 'r':
+                resume_flag = 1;
+                break;
+
+            case 'G':
+                seed = strtoull(optarg, NULL, 0);
+                seed_flag = 1;
+                break;
+
+            case 'Q':
+                if (sscanf(optarg, "%d/%d", &shard, &shards) != 2)
+                    shards = 0;
+                break;
+
+            case 'W':
+                strcpy(sweep_filename, optarg);
+                break;
+
+            case 'E':
+                if (!strcmp(optarg, "sequential"))
+                    schedule = BCJR_SEQUENTIAL;
+                else if (!strcmp(optarg, "middle"))
+                    schedule = BCJR_MIDDLE;
+                else if (!strcmp(optarg, "middle-threads"))
+                    schedule = BCJR_MIDDLE_THREADS;
+                else {
+                    printf(BOLDRED "Schedule must be sequential, middle or middle-threads.\n" RESET);
+                    exit(EXIT_FAILURE);
+                }
+                break;
+
+            case 'R':
+                radix = (int) strtol(optarg, NULL, 10);
+                break;
+
+            case 'L':
+                single_precision_flag = 1;
+                break;
+
+            case 'd':
+                if (!strcmp(optarg, "log-map"))
+                    decoder = SISO_LOG_MAP;
+                else if (!strcmp(optarg, "probability"))
+                    decoder = SISO_PROBABILITY;
+                else if (!strcmp(optarg, "sova"))
+                    decoder = SISO_SOVA;
+                else {
+                    printf(BOLDRED "Decoder must be log-map, probability or sova.\n" RESET);
+                    exit(EXIT_FAILURE);
+                }
+                break;
+
+            case 'J':
+                interleaver_spec = optarg;
+                break;
+
+            case 'D':
+                strcpy(store_filename, optarg);
+                break;
+
             case 'l':
                 packet_length = (int) strtof(optarg, NULL);
                 break;
@@ -131,13 +460,101 @@ int main(int argc, char *argv[])
                         "a comma-separated format in FILENAME. If this argument is not used, the results will be saved in "
                         "a file named with the current date and time.");
 
-                printf(BOLDMAGENTA "%20s" RESET "\n\t%s\n\n" , "-c / --packet-count INTEGER", "set the number of packets to encode/decode."
-                        " INTEGER can be given in exponential notation i.e. 1e4 for 10000 packets.");
+                printf(BOLDMAGENTA "%20s" RESET "\n\t%s\n\n" , "-c / --packet-count INTEGER", "set the maximum number of packets to encode/decode"
+                        " at each SNR point. INTEGER can be given in exponential notation i.e. 1e4 for 10000 packets.");
+
+                printf(BOLDMAGENTA "%20s" RESET "\n\t%s\n\n" , "-e / --min-errors INTEGER", "set the minimum number of erroneous"
+                        " packets to observe before an SNR point can be stopped.");
+
+                printf(BOLDMAGENTA "%20s" RESET "\n\t%s\n\n" , "-p / --precision FLOAT", "stop an SNR point once the confidence"
+                        " intervals on BER and PER are within this relative half-width, i.e. 0.1 for +/-10%.");
+
+                printf(BOLDMAGENTA "%20s" RESET "\n\t%s\n\n" , "-z / --confidence FLOAT", "set the confidence level of the"
+                        " intervals, i.e. 0.95.");
 
                 printf(BOLDMAGENTA "%20s" RESET "\n\t%s\n\n" , "-C / --cores INTEGER", "set the number of CPU cores to use.");
 
+                printf(BOLDMAGENTA "%20s" RESET "\n\t%s\n\n" , "-B / --batch-size INTEGER", "set the number of packets in a unit of work"
+                        " handed to a core. If not given, it is chosen from the packet count and the number of cores.");
+
+                printf(BOLDMAGENTA "%20s" RESET "\n\t%s\n\n" , "-P / --prune", "decode the SNR points of a packet from the"
+                        " lowest to the highest and credit the higher points as error-free once the packet is decoded correctly.");
+
+                printf(BOLDMAGENTA "%20s" RESET "\n\t%s\n\n" , "-K / --prune-check FLOAT", "fraction of the packets that are"
+                        " decoded anyway at every point when pruning, to validate the assumption. Defaults to 0.05.");
+
+                printf(BOLDMAGENTA "%20s" RESET "\n\t%s\n\n" , "-T / --throughput SECONDS", "instead of estimating"
+                        " BER and PER, decode a stream of pre-generated noisy frames for SECONDS on the selected number of"
+                        " cores and report throughput and per-frame latency percentiles.");
+
+                printf(BOLDMAGENTA "%20s" RESET "\n\t%s\n\n" , "-S / --throughput-SNR FLOAT", "Eb/N0 in dB of the"
+                        " frames decoded in throughput mode. Defaults to 1 dB.");
+
+                printf(BOLDMAGENTA "%20s" RESET "\n\t%s\n\n" , "-F / --frames INTEGER", "number of distinct frames in"
+                        " the stream decoded in throughput mode. Defaults to 64.");
+
+                printf(BOLDMAGENTA "%20s" RESET "\n\t%s\n\n" , "-H / --perf", "sample hardware performance counters"
+                        " around the decoder kernels and report cycles per trellis edge and cache misses per bit.");
+
+                printf(BOLDMAGENTA "%20s" RESET "\n\t%s\n\n" , "-I / --progress SECONDS", "print packets per second,"
+                        " ETA and the running error counts of every SNR point every SECONDS (default 10, 0 to disable).");
+
+                printf(BOLDMAGENTA "%20s" RESET "\n\t%s\n\n" , "-s / --status-file FILENAME", "also write the progress"
+                        " report in FILENAME, replaced atomically. With --skip-confirm it defaults to <output>.status.");
+
+                printf(BOLDMAGENTA "%20s" RESET "\n\t%s\n\n" , "-X / --checkpoint SECONDS", "save the counters of every"
+                        " SNR point and the position of every packet stream in <output>.ckpt every SECONDS, on SIGINT/SIGTERM"
+                        " and at the end of the run (default 600, 0 to disable).");
+
+                printf(BOLDMAGENTA "%20s" RESET "\n\t%s\n\n" , "-r / --resume", "continue the run saved in <output>.ckpt."
+                        " Codes, multipliers, SNR grid and iterations must match; the packet count can be increased.");
+
+                printf(BOLDMAGENTA "%20s" RESET "\n\t%s\n\n" , "-G / --seed INTEGER", "seed of the packet and noise"
+                        " streams. Defaults to the current time.");
+
+                printf(BOLDMAGENTA "%20s" RESET "\n\t%s\n\n" , "-Q / --shard I/N", "simulate only shard I of N"
+                        " (0 <= I < N) of the packets. Shards run with the same seed, packet count and parameters on any"
+                        " number of machines, their <output>.counts.csv files are combined with deepspace_merge.");
+
+                printf(BOLDMAGENTA "%20s" RESET "\n\t%s\n\n" , "-W / --sweep FILENAME", "simulate every configuration"
+                        " described in FILENAME in a single run. Each [section] lists codes, multipliers and iterations"
+                        " (code = 1,2) and may set min-SNR, max-SNR, SNR-points, packet-count, min-errors and precision;"
+                        " settings before the first section or in [defaults] apply to the following sections. Results"
+                        " are saved in a single table with one row per configuration and SNR point.");
+
+                printf(BOLDMAGENTA "%20s" RESET "\n\t%s\n\n" , "-R / --radix INT", "trellis steps merged by the"
+                        " decoders: 2 processes one step at a time, 4 merges two steps into four branches per state."
+                        " Both give the same results.");
+
+                printf(BOLDMAGENTA "%20s" RESET "\n\t%s\n\n" , "-E / --schedule NAME", "order of the BCJR recursions:"
+                        " sequential (default), or middle to run the forward and backward recursions from the two ends"
+                        " of the frame towards its middle, storing half the messages. middle-threads runs them on two"
+                        " threads when the decoder is not already on a worker thread. Results are the same. Radix-4"
+                        " decoding always uses the sequential schedule.");
+
+                printf(BOLDMAGENTA "%20s" RESET "\n\t%s\n\n" , "-L / --float", "run the turbo decoder in single"
+                        " precision: half the memory traffic, slightly different results. It ignores --radix and"
+                        " --schedule, and the results store keeps its counters apart.");
+
+                printf(BOLDMAGENTA "%20s" RESET "\n\t%s\n\n" , "-d / --decoder NAME", "constituent decoder of the"
+                        " turbo decoder: log-map (default), the BCJR on log-probabilities, probability, the BCJR on"
+                        " probabilities scaled at every step, or sova, the soft-output Viterbi algorithm. The first two"
+                        " are exact, the SOVA trades some coding gain for speed and memory. probability and sova ignore"
+                        " --radix and --schedule. Results are stored per decoder.");
+
+                printf(BOLDMAGENTA "%20s" RESET "\n\t%s\n\n" , "-J / --interleaver SPEC", "replace the CCSDS interleaver"
+                        " with a quadratic permutation polynomial, qpp:F1,F2 for pi(i) = (F1*i + F2*i^2) mod k, or an"
+                        " almost regular permutation, arp:P,S0,...,SC-1 for pi(i) = (P*i + S[i mod C]) mod k. The"
+                        " parallelism degrees for which it is contention-free are reported.");
+
+                printf(BOLDMAGENTA "%20s" RESET "\n\t%s\n\n" , "-D / --store FILENAME", "accumulate results in the"
+                        " append-only store FILENAME. Counters of earlier runs with the same code, multiplier, iterations,"
+                        " decoder and Eb/N0 are added to the estimates, and points that already meet their stopping rules"
+                        " are not simulated again; the packet count is the total over all the runs.");
+
                 printf(BOLDMAGENTA "%20s" RESET "\n\t%s\n\n" , "-k / --multiplier INT", "set the input packet length through the following "
-                        " formula: packet-length = 223 * 8 * multiplier");
+                        " formula: packet-length = 223 * 8 * multiplier. A comma-separated list, i.e. 1,2,4,5, simulates"
+                        " several lengths in the same run.");
 
                 printf(BOLDMAGENTA "%20s" RESET "\n\t%s\n\n" , "-l / --packet-length INTEGER", "set the number of information bits"
                         " in a packet. Exponential notation can be used.");
@@ -151,15 +568,17 @@ int main(int argc, char *argv[])
 
                 printf(BOLDMAGENTA "%20s" RESET "\n\t%s\n\n" , "-i / --iterations", "set the number of iterations for the turbo decoding algorithm.");
 
-                printf(BOLDMAGENTA "%20s" RESET "\n\t%s\n\n" , "-t / --code", "Select the code to test. 1 for R=1/2, 2 for R=1/3, 3 for R=1/4 and 4 for R=1/6");
+                printf(BOLDMAGENTA "%20s" RESET "\n\t%s\n\n" , "-t / --code", "Select the code to test. 1 for R=1/2, 2 for R=1/3, 3 for R=1/4 and 4 for R=1/6."
+                        " A comma-separated list, i.e. 1,2,3,4, simulates several codes on the same packets and noise;"
+                        " results are then saved in one file per code and multiplier.");
                 exit(EXIT_SUCCESS);
 
             case 'm':
-                min_SNR = strtof(optarg, NULL);
+                min_SNR = strtod(optarg, NULL);
                 break;
 
             case 'M':
-                max_SNR = strtof(optarg, NULL);
+                max_SNR = strtod(optarg, NULL);
                 break;
 
             case 'n':
@@ -171,11 +590,11 @@ int main(int argc, char *argv[])
                 break;
 
             case 'k':
-                octets = (int)strtol(optarg, NULL, 10);
+                octets_count = parse_list(optarg, octets, MAX_CONFIGS);
                 break;
 
             case 't':
-                code_type = (int)strtol(optarg, NULL, 10);
+                codes_count = parse_list(optarg, code_types, MAX_CONFIGS);
                 break;
 
             case 'o':
@@ -208,13 +627,94 @@ int main(int argc, char *argv[])
         exit(EXIT_FAILURE);
     }
 
+    if (min_errors < 0 || precision <= 0){
+        printf(BOLDRED "Minimum number of errors must be non-negative and target precision strictly positive.\n" RESET);
+        exit(EXIT_FAILURE);
+    }
+
+    if (confidence <= 0 || confidence >= 1){
+        printf(BOLDRED "Confidence level must be in (0, 1).\n" RESET);
+        exit(EXIT_FAILURE);
+    }
+
+    if (prune_check < 0 || prune_check > 1){
+        printf(BOLDRED "Fraction of spot-checked packets must be in [0, 1].\n" RESET);
+        exit(EXIT_FAILURE);
+    }
+
+    if (progress_interval < 0){
+        printf(BOLDRED "Progress interval must be non-negative.\n" RESET);
+        exit(EXIT_FAILURE);
+    }
+
+    if (checkpoint_interval < 0){
+        printf(BOLDRED "Checkpoint interval must be non-negative.\n" RESET);
+        exit(EXIT_FAILURE);
+    }
+
+    if (resume_flag && (!filename_flag || !checkpoint_interval)){
+        printf(BOLDRED "Resuming needs the output filename of the interrupted run and checkpoints enabled.\n" RESET);
+        exit(EXIT_FAILURE);
+    }
+
+    if (shards <= 0 || shard < 0 || shard >= shards){
+        printf(BOLDRED "Shard must be given as I/N with 0 <= I < N.\n" RESET);
+        exit(EXIT_FAILURE);
+    }
+
+    if (shards > 1 && !seed_flag){
+        printf(BOLDRED "Sharded runs need an explicit seed, shared by all the shards.\n" RESET);
+        exit(EXIT_FAILURE);
+    }
+
+    if (radix != 2 && radix != 4){
+        printf(BOLDRED "Radix must be 2 or 4.\n" RESET);
+        exit(EXIT_FAILURE);
+    }
+
+    if (single_precision_flag && decoder != SISO_LOG_MAP){
+        printf(BOLDRED "Single precision is only available for the log-map decoder.\n" RESET);
+        exit(EXIT_FAILURE);
+    }
+
+    // the registry builds one code per set of decoder options
+    t_turbooptions options = TURBO_DEFAULT_OPTIONS;
+    options.radix = radix;
+    options.schedule = schedule;
+    options.decoder = decoder;
+    options.single_precision = single_precision_flag;
+
+    if (interleaver_spec && store_filename[0]){
+        printf(BOLDRED "The results store only holds codes with the CCSDS interleaver.\n" RESET);
+        exit(EXIT_FAILURE);
+    }
+
+    if (throughput_seconds < 0 || throughput_frames <= 0){
+        printf(BOLDRED "Throughput duration must be non-negative and the number of frames strictly positive.\n" RESET);
+        exit(EXIT_FAILURE);
+    }
+
     if (packet_length <= 0){
         printf(BOLDRED "Number of information bits in a packet must be strictly positive.\n" RESET);
         exit(EXIT_FAILURE);
     }
 
-    if (octets <= 0){
-        printf(BOLDRED "Packet length multiplier must be strictly positive.\n" RESET);
+    for (int i = 0; i < octets_count; i++) {
+        if (octets[i] <= 0){
+            printf(BOLDRED "Packet length multiplier must be strictly positive.\n" RESET);
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    for (int i = 0; i < codes_count; i++) {
+        if (code_types[i] < 1 || code_types[i] > 4){
+            printf(BOLDRED "Code must be 1, 2, 3 or 4.\n" RESET);
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    if (!codes_count || !octets_count || codes_count * octets_count > MAX_CONFIGS){
+        printf(BOLDRED "Between 1 and %d combinations of codes and multipliers can be simulated.\n" RESET, MAX_CONFIGS);
         exit(EXIT_FAILURE);
     }
 
@@ -229,54 +729,97 @@ int main(int argc, char *argv[])
         printf("Output filename not provided. File " BOLDMAGENTA "\'%s\'" RESET " will be used. \n", filename);
     }
 
-    // build interleaver
-    int base = 223;
-    int info_length = base * 8 * octets;
-    int p[8] = {31, 37, 43, 47, 53, 59, 61, 67};
-    int k1 = 8;
-    int k2 = base * octets;
+    // unattended runs keep their progress next to the results
+    if (skipconfirm_flag && !status_filename[0])
+        snprintf(status_filename, sizeof(status_filename), "%s.status", filename);
+
+    // configurations to simulate: every code and multiplier of the command
+    // line, or every combination listed in the sections of a sweep file
+    t_sweepentry defaults;
+    defaults.code_type = code_types[0];
+    defaults.octets = octets[0];
+    defaults.iterations = iterations;
+    defaults.min_SNR = min_SNR;
+    defaults.max_SNR = max_SNR;
+    defaults.SNR_points = SNR_points;
+    defaults.num_packets = num_packets;
+    defaults.min_errors = min_errors;
+    defaults.precision = precision;
+
+    t_sweep *sweep = sweep_initialize();
+    if (sweep_filename[0]) {
+        int error = sweep_load(sweep, sweep_filename, &defaults);
+        if (error < 0){
+            perror("Couldn't read sweep file");
+            exit(EXIT_FAILURE);
+        }
+        if (error > 0 || !sweep->entries_count){
+            printf(BOLDRED "Invalid sweep file \'%s\' (line %d).\n" RESET, sweep_filename, error);
+            exit(EXIT_FAILURE);
+        }
+    } else {
+        for (int t = 0; t < codes_count; t++) {
+            for (int o = 0; o < octets_count; o++) {
+                t_sweepentry entry = defaults;
+                entry.code_type = code_types[t];
+                entry.octets = octets[o];
+                sprintf(entry.name, "code%d_k%d", code_types[t], octets[o]);
+                sweep_add(sweep, &entry);
+            }
+        }
+    }
 
-    int *pi = malloc(info_length * sizeof *pi);
+    // a custom interleaver must be a permutation for every packet length
+    if (interleaver_spec) {
+        for (int n = 0; n < sweep->entries_count; n++) {
+            t_sweepentry *entry = &sweep->entries[n];
+            int info_length = 223 * 8 * entry->octets;
+            t_ccsdscode *code = ccsds_code_interleaved(entry->code_type, entry->octets, interleaver_spec, &options);
+            if (!code){
+                printf(BOLDRED "\'%s\' is not a permutation of %d bits.\n" RESET, interleaver_spec, info_length);
+                exit(EXIT_FAILURE);
+            }
 
-    for (int s = 1; s <= info_length; ++s) {
-        int m = (s-1) % 2;
-        int i = (int) floor((s-1) / (2 * k2));
-        int j = (int) floor((s-1) / 2) - i*k2;
-        int t = (19*i + 1) % (k1/2);
-        int q = t % 8 + 1;
-        int c = (p[q-1]*j + 21*m) % k2;
-        pi[s-1] = 2*(t + c*(k1/2) + 1) - m - 1;
+            int reported = 0;
+            for (int m = 0; m < n && !reported; m++)
+                reported = sweep->entries[m].octets == entry->octets;
+            if (reported)
+                continue;
+
+            // parallel decoders split the frame in equal windows
+            printf("Interleaver of %d bits, contention-free for", info_length);
+            int degrees = 0;
+            for (int parallelism = 2; parallelism <= info_length / 2; parallelism *= 2) {
+                if (interleaver_contention_free(code->interleaver, info_length, parallelism) == 1) {
+                    printf(" %d", parallelism);
+                    degrees++;
+                }
+            }
+            printf(degrees ? " windows.\n" : " no power of two windows.\n");
+        }
     }
 
     // print simulation parameters
     if (!skipconfirm_flag){
         char header[PATH_MAX];
         int w = 15;
-        sprintf(header, "|%-*s|%-*s|%-*s|%-*s|%-*s|", w, "Packet length", w, "Packet count",
-                w, "Min SNR [dB]", w, "Max SNR [dB]", w, "SNR points");
+        sprintf(header, "|%-*s|%-*s|%-*s|%-*s|%-*s|%-*s|%-*s|", 2*w, "Configuration", w, "Packet length",
+                w, "Iterations", w, "Packet count", w, "Min SNR [dB]", w, "Max SNR [dB]", w, "SNR points");
 
         int header_length = (int)strlen(header);
-        for (int l = 0; l < header_length; ++l) {
-            char ch =  (l % (w+1)) ? '-' : '+';
-            printf("%c", ch);
-        }
-
-        printf("\n%s\n", header);
-        for (int l = 0; l < header_length; ++l) {
-            char ch =  (l % (w+1)) ? '-' : '+';
-            printf("%c", ch);
+        char rule[PATH_MAX];
+        for (int l = 0; l < header_length; ++l)
+            rule[l] = (header[l] == '|') ? '+' : '-';
+        rule[header_length] = '\0';
+
+        printf("%s\n%s\n%s\n", rule, header, rule);
+        for (int n = 0; n < sweep->entries_count; n++) {
+            t_sweepentry *entry = &sweep->entries[n];
+            printf("|%-*s|%-*d|%-*d|%-*d|%-*f|%-*f|%-*d|\n", 2*w, entry->name, w, 223 * 8 * entry->octets,
+                   w, entry->iterations, w, entry->num_packets, w, entry->min_SNR, w, entry->max_SNR,
+                   w, entry->SNR_points);
         }
-
-        char data_str[256];
-        sprintf(data_str, "|%-*d|%-*d|%-*f|%-*f|%-*d|", w, info_length, w, num_packets,
-                w, min_SNR, w, max_SNR, w, SNR_points);
-        printf("\n%s\n", data_str);
-
-        for (int l = 0; l < header_length; ++l) {
-            char ch =  (l % (w+1)) ? '-' : '+';
-            printf("%c", ch);
-        }
-        printf("\n");
+        printf("%s\n", rule);
     }
 
     // confirmation
@@ -290,264 +833,133 @@ int main(int argc, char *argv[])
         exit(EXIT_SUCCESS);
     }
 
-    printf("\nSimulation starting...\n\n");
-
-    // create output file
-    FILE *file = fopen(filename, "w");
-    if (!file){
-        perror("Something went wrong. Couldn't create output file");
-        exit(EXIT_FAILURE);
+    printf("\nSimulation starting, " BOLDMAGENTA "%s" RESET " kernels...\n\n", cpu_isa_name(cpu_isa_selected));
+
+    // codes to simulate come from the registry, all of them see the same packets
+    // and noise. Configurations that only differ in iterations, SNR grid or
+    // stopping rules share their trellis and interleaver tables
+    int entries_count = sweep->entries_count;
+
+    t_simulation *sim = simulation_initialize();
+    sim->num_packets = 0;
+    sim->min_errors = min_errors;
+    sim->precision = precision;
+    sim->confidence = confidence;
+    sim->prune = prune_flag;
+    sim->prune_check = prune_check;
+    sim->batch_size = batch_size;
+    sim->threads = cores;
+    sim->seed = seed_flag ? (uint64_t) seed : (uint64_t) time(NULL);
+    sim->shard = shard;
+    sim->shards = shards;
+    sim->progress_interval = progress_interval;
+    sim->status_file = status_filename[0] ? status_filename : NULL;
+
+    char checkpoint_filename[PATH_MAX];
+    snprintf(checkpoint_filename, sizeof(checkpoint_filename), "%s.ckpt", filename);
+    sim->checkpoint_interval = checkpoint_interval;
+    sim->checkpoint_file = checkpoint_interval > 0 ? checkpoint_filename : NULL;
+
+    for (int n = 0; n < entries_count; n++) {
+        t_sweepentry *entry = &sweep->entries[n];
+
+        t_ccsdscode *code = ccsds_code_interleaved(entry->code_type, entry->octets, interleaver_spec, &options);
+
+        double *EbN0_dB = linspace(entry->min_SNR, entry->max_SNR, entry->SNR_points);
+        int c = simulation_add_config(sim, entry->name, code->turbo, code->puncturing_pattern, code->rate,
+                                      entry->iterations, EbN0_dB, entry->SNR_points);
+        free(EbN0_dB);
+
+        sim->configs[c].code_type = entry->code_type;
+        sim->configs[c].octets = entry->octets;
+        sim->configs[c].num_packets = entry->num_packets;
+        sim->configs[c].min_errors = entry->min_errors;
+        sim->configs[c].precision = entry->precision;
+        sim->num_packets = entry->num_packets > sim->num_packets ? entry->num_packets : sim->num_packets;
     }
 
-    // allocate memory to store parameters and results
-    double *EbN0_dB = linspace(min_SNR, max_SNR, SNR_points);
-    double *sigma = malloc(SNR_points* sizeof *sigma);
-    long int *errors = calloc(SNR_points, sizeof *errors);
-    int *erroneous_packets = calloc(SNR_points, sizeof *erroneous_packets);//needed to estimate PER (Packer Error Probability)
-    double *BER = malloc(SNR_points*sizeof *BER);
-    double *PER = malloc(SNR_points*sizeof *PER);
-    int *processed_packets = calloc(SNR_points, sizeof *processed_packets);
-
-    // define codes
-    char *forward_upper[MAX_COMPONENTS];
-    char *forward_lower[MAX_COMPONENTS];
-    t_convcode *code1;
-    t_convcode *code2;
-    t_turbocode *turbo;
-    int N_components_upper = 2;
-    int N_components_lower = 1;
-
-    char *backward;
-    backward = "0011";
-
-
-    // build selected code
-    switch (code_type){
-
-        case 1:
-            N_components_upper = 2;
-            N_components_lower = 1;
-
-
-            forward_upper[0] = "10011"; // systematic output
-            forward_upper[1] = "11011";
-
-            forward_lower[0] = "11011";
-            // need to define puncturing pattern here maybe with a pointer to function
-            // 110 101 110 101 110 101
-
-            code1 = convcode_initialize(forward_upper, backward, N_components_upper);
-            code2 = convcode_initialize(forward_lower, backward, N_components_lower);
-            turbo = turbo_initialize(code1, code2, pi, info_length);
-            rate = 1.0/2.0;
-
-            puncturing_pattern = malloc(turbo->encoded_length * sizeof *puncturing_pattern);
-
-            // build puncturing pattern
-            for (int i = 0; i < turbo->encoded_length; ++i) {
-                puncturing_pattern[i] = puncturing(i);
-            }
-            break;
-
-        case 2:
-            N_components_upper = 2;
-            N_components_lower = 1;
-
-            forward_upper[0] = "10011"; // systematic output
-            forward_upper[1] = "11011";
-
-            forward_lower[0] = "11011"; // no need for puncturing
-
-            code1 = convcode_initialize(forward_upper, backward, N_components_upper);
-            code2 = convcode_initialize(forward_lower, backward, N_components_lower);
-            turbo = turbo_initialize(code1, code2, pi, info_length);
-            rate = 1/3.0;
-            break;
-
-        case 3:
-            N_components_upper = 3;
-            N_components_lower = 1;
-
-            forward_upper[0] = "10011"; // systematic output
-            forward_upper[1] = "10101";
-            forward_upper[2] = "11111";
-
-            forward_lower[0] = "11011"; // no need for puncturing
-
-            code1 = convcode_initialize(forward_upper, backward, N_components_upper);
-            code2 = convcode_initialize(forward_lower, backward, N_components_lower);
-            turbo = turbo_initialize(code1, code2, pi, info_length);
-            rate = 1/4.0;
-            break;
-
-        case 4:
-            N_components_upper = 4;
-            N_components_lower = 2;
-
-            forward_upper[0] = "10011"; // systematic output
-            forward_upper[1] = "11011";
-            forward_upper[2] = "10101";
-            forward_upper[3] = "11111";
-
-            forward_lower[0] = "11011"; // no need for puncturing
-            forward_lower[1] = "11111";
+    // earlier runs in the store count towards the stopping rules
+    int store_flag = store_filename[0] && throughput_seconds <= 0;
+    if (store_flag) {
+        int matched = store_load(sim, store_filename);
+        if (matched < 0){
+            printf(BOLDRED "Results store \'%s\' is malformed.\n" RESET, store_filename);
+            exit(EXIT_FAILURE);
+        }
 
-            code1 = convcode_initialize(forward_upper, backward, N_components_upper);
-            code2 = convcode_initialize(forward_lower, backward, N_components_lower);
-            turbo = turbo_initialize(code1, code2, pi, info_length);
-            rate = 1/6.0;
-            break;
+        int points = 0;
+        for (int n = 0; n < sim->configs_count; n++)
+            points += sim->configs[n].SNR_points;
+        printf("%d of %d points already meet their stopping rules in " BOLDMAGENTA "\'%s\'" RESET ".\n",
+               simulation_retire(sim), points, store_filename);
     }
 
-    // get noise std variation from SNR
-    for (int i = 0; i < SNR_points; i++)
-    {
-        double EbN0 = pow(10, EbN0_dB[i]/10.0);
-        sigma[i] = sqrt(1.0/(EbN0*2*rate));
+    if (resume_flag && throughput_seconds <= 0) {
+        if (simulation_load_checkpoint(sim, checkpoint_filename)) {
+            printf(BOLDRED "Checkpoint \'%s\' is unreadable or does not match the simulation parameters.\n" RESET,
+                   checkpoint_filename);
+            exit(EXIT_FAILURE);
+        }
+        printf("Resuming from " BOLDMAGENTA "\'%s\'" RESET ", %ld packets already simulated.\n", checkpoint_filename,
+               sim->completed_packets);
     }
 
-    int max_cores = omp_get_num_procs();
-    int max_threads = omp_get_max_threads();
-
-    // simulation loop
-    // initialize seed of RNG/*{{{*/
-    srand(time(NULL));
-
-    // number of erroneous bits for each tested packet
-    int packet_count = 0;
-    int interval = num_packets * 0.05 + 1;
-
-
-    // simulation loop
-    omp_set_num_threads(cores);
-    #pragma omp parallel
-    {
-        #pragma omp for nowait
-        for (int k = 0; k < num_packets; k++)
-        {
-            packet_count++;
-            // generate packet
-            int *packet = randbits(info_length);
-
-            printf("Processing packet #%d/%d\n", packet_count, num_packets);
-
-            //double *noise_sequence = randn(0, 1, packet_length);
-            double *noise_seq_coded = randn(0, 1, turbo->encoded_length);
-
-            for (int s = 0; s < SNR_points; s++){
-                if (errors[s] < error_threshold){
-                    errors[s] += simulate_turbo(packet, noise_seq_coded, info_length, sigma[s], turbo,
-                                                iterations, puncturing_pattern);
-                    erroneous_packets[s] += errors[s] != 0;
-                    processed_packets[s]++;
-                }
-            }
-
-            free(packet);
-            //free(noise_sequence);
-            free(noise_seq_coded);
+    // the packets of this run must not be in the store already
+    if (store_flag && store_seed_used(store_filename, sim->seed, sim->shard, sim->shards)) {
+        if (seed_flag || resume_flag){
+            printf(BOLDRED "Seed %llu is already in \'%s\', its packets would be counted twice.\n" RESET,
+                   (unsigned long long) sim->seed, store_filename);
+            exit(EXIT_FAILURE);
         }
-    }/*}}}*/
-
-    // compute BER and PER
-    for (int i = 0; i < SNR_points; i++)
-    {
-
-        PER[i] = (double) erroneous_packets[i]/(processed_packets[i]);
-        BER[i] = (double) errors[i]/(processed_packets[i]*info_length);
+        while (store_seed_used(store_filename, sim->seed, sim->shard, sim->shards))
+            sim->seed++;
     }
 
-    printf(BOLDGREEN "\nSimulation completed.\n\n" RESET);
-
-    // save results
-    char *headers[] = {"EbN0", "BER", "PER"};
-    save_data(EbN0_dB, BER, PER, headers, SNR_points, file);
-    fclose(file);
-
-    // print results
-    printf(BOLDYELLOW "%20s%20s%20s\n" RESET, "EbN0 [dB]", "BER", "PER");
-    for (int j = 0; j < SNR_points; ++j)
-       printf("%20f%20.4e%20.4e\n", EbN0_dB[j], BER[j], PER[j]);
-
-
-    convcode_clear(code1);
-    convcode_clear(code2);
-
-    // release allocated memory
-    free(erroneous_packets);
-    free(processed_packets);
-    free(BER);
-    free(PER);
-    free(errors);
-    free(EbN0_dB);
-    free(sigma);
-    free(puncturing_pattern);
-    free(code1);
-    free(code2);
-    free(turbo);
-
-    return 0;
-}
-
-// thread routines
-int simulate_awgn(int *packet, double *noise_sequence, int packet_length, double sigma)/*{{{*/
-{
-    int errors = 0;/*{{{*/
-    for (int i = 0; i < packet_length; i++){
-        double received = sigma*noise_sequence[i] + (2*packet[i]-1);
-        errors += (received > 0) != packet[i];
+    // hardware counters are optional: the run goes on without them
+    if (perf_flag && !perf_kernels_enable())
+        printf(BOLDRED "Hardware performance counters are not available, --perf is ignored.\n" RESET);
+
+    if (throughput_seconds > 0)
+        run_throughput(sim, filename, throughput_SNR, throughput_frames, throughput_seconds, cores);
+    else
+        run_sweep(sim, sweep, filename, confidence, prune_flag, sweep_filename[0] != '\0');
+
+    // interrupted runs are added once they are resumed and completed
+    if (store_flag && !sim->interrupted) {
+        if (store_append(sim, store_filename))
+            perror("Couldn't append to the results store");
+        else
+            printf("Results added to " BOLDMAGENTA "\'%s\'" RESET "\n", store_filename);
     }
-    return errors;/*}}}*/
-}
 
-int simulate_conv(int *packet, double *noise_sequence, int packet_length, double sigma, t_convcode *code)
-{
-    int errors = 0;/*{{{*/
-    int *encoded = convcode_encode(packet, packet_length, code);
-    int encoded_length = code->components*(packet_length + code->memory);
-
-    double *received = malloc(encoded_length * sizeof *received);
-    for (int i = 0; i < encoded_length; i++)
-        received[i] = (2*encoded[i] - 1) + sigma*noise_sequence[i];
-
-//    int *decoded = convcode_decode(received, encoded_length, code);
-    double **a_priori = malloc(2*sizeof(double*));
-    for (int k = 0; k < 2; ++k) {
-        a_priori[k] = malloc(packet_length * sizeof(double));
-        for (int i = 0; i < packet_length; ++i) {
-            a_priori[k][i] = log(0.5);
-        }
+#ifdef DEEPSPACE_PROFILE
+    // per-stage timings are saved next to the results
+    char profile_filename[PATH_MAX];
+    snprintf(profile_filename, sizeof(profile_filename), "%s.profile.json", filename);
+    if (profile_save(profile_filename))
+        perror("Couldn't save profiling data");
+    else
+        printf("Profiling data saved in " BOLDMAGENTA "\'%s\'" RESET "\n", profile_filename);
+#endif
+
+    if (perf_kernels_enabled) {
+        char perf_filename[PATH_MAX];
+        snprintf(perf_filename, sizeof(perf_filename), "%s.perf.csv", filename);
+        printf("\n");
+        perf_kernels_print();
+        if (perf_kernels_save(perf_filename))
+            perror("Couldn't save performance counters");
+        else
+            printf("Performance counters saved in " BOLDMAGENTA "\'%s\'" RESET "\n", perf_filename);
     }
-    int *decoded = convcode_extrinsic(received, encoded_length, &a_priori, code, sigma*sigma, 1);
-    for (int j = 0; j < packet_length; ++j)
-        errors += (decoded[j] != packet[j]);
 
-    free(decoded);
-    free(encoded);
-    free(received);
-    return errors;/*}}}*/
-}
-
-int simulate_turbo(int *packet, double *noise_sequence, int packet_length, double sigma, t_turbocode *code, int iterations,
-                   int *puncturing_pattern)
-{
-    int errors = 0;/*{{{*/
-    int *encoded = turbo_encode(packet, code);
-    int encoded_length = code->encoded_length;
-
-    double *received = malloc(encoded_length * sizeof *received);
-    for (int i = 0; i < encoded_length; i++) {
-        double r = (2 * encoded[i] - 1) + sigma * noise_sequence[i];
-        double kkk = (puncturing_pattern) ? puncturing_pattern[i] * r : r;
-        received[i] = kkk;
-    }
+    // release allocated memory
+    simulation_clear(sim);
+    free(sim);
 
-    int *decoded = turbo_decode(received, iterations, sigma*sigma, code);
-    for (int j = 0; j < packet_length; ++j)
-        errors += (decoded[j] != packet[j]);
+    ccsds_registry_clear();
+    sweep_clear(sweep);
+    free(sweep);
 
-    free(decoded);
-    free(encoded);
-    free(received);
-    return errors;/*}}}*/
+    return 0;
 }
@@ -0,0 +1,257 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <limits.h>
+#include <getopt.h>
+#include "libsimulation.h"
+#include "utilities.h"
+#include "colors.h"
+
+// counters of an SNR point of a configuration, summed over the inputs
+typedef struct str_mergepoint{
+    char name[64];
+    int info_length;
+    t_simpoint point;
+} t_mergepoint;
+
+// identity of the packets simulated by an input
+typedef struct str_mergesource{
+    unsigned long long seed;
+    int shard;
+    int shards;
+} t_mergesource;
+
+static int mergepoint_compare(const void *a, const void *b)
+{
+    const t_mergepoint *x = a;
+    const t_mergepoint *y = b;
+    int names = strcmp(x->name, y->name);
+    if (names)
+        return names;
+    return (x->point.EbN0_dB > y->point.EbN0_dB) - (x->point.EbN0_dB < y->point.EbN0_dB);
+}
+
+// add the rows of a counters file, return the number of rows or -1. source
+// is the identity of the first row, all zeros if there are none
+static int merge_file(char *filename, t_mergepoint **points, int *points_count, t_mergesource *source)
+{
+    FILE *file = fopen(filename, "r");/*{{{*/
+    if (!file)
+        return -1;
+
+    char line[1024];
+    int rows = 0;
+    memset(source, 0, sizeof *source);
+
+    // skip the header
+    if (!fgets(line, sizeof(line), file)) {
+        fclose(file);
+        return -1;
+    }
+
+    while (fgets(line, sizeof(line), file)) {
+        t_mergepoint row;
+        memset(&row, 0, sizeof row);
+        t_simpoint *p = &row.point;
+        double bits;
+        t_mergesource s;
+
+        if (sscanf(line, "%63[^,],%d,%lf,%ld,%ld,%ld,%ld,%lf,%ld,%ld,%ld,%llu,%d,%d", row.name, &row.info_length,
+                   &p->EbN0_dB, &p->processed_packets, &p->erroneous_packets, &p->errors, &p->errors_squared, &bits,
+                   &p->pruned_packets, &p->checked_packets, &p->violations, &s.seed, &s.shard, &s.shards) != 14) {
+            fclose(file);
+            return -1;
+        }
+
+        if (!rows)
+            *source = s;
+
+        // look for the same point in the previous inputs
+        int i;
+        for (i = 0; i < *points_count; i++)
+            if (!strcmp((*points)[i].name, row.name) && fabs((*points)[i].point.EbN0_dB - p->EbN0_dB) < 1e-9)
+                break;
+
+        if (i == *points_count) {
+            *points = realloc(*points, (*points_count + 1) * sizeof **points);
+            (*points)[(*points_count)++] = row;
+        } else if ((*points)[i].info_length != row.info_length) {
+            fclose(file);
+            return -1;
+        } else {
+            t_simpoint *total = &(*points)[i].point;
+            total->processed_packets += p->processed_packets;
+            total->erroneous_packets += p->erroneous_packets;
+            total->errors += p->errors;
+            total->errors_squared += p->errors_squared;
+            total->pruned_packets += p->pruned_packets;
+            total->checked_packets += p->checked_packets;
+            total->violations += p->violations;
+        }
+        rows++;
+    }
+
+    fclose(file);
+    return rows;/*}}}*/
+}
+
+int main(int argc, char *argv[])
+{
+    double confidence = 0.95;
+    char filename[PATH_MAX] = "merged.csv";
+
+    // parse command line arguments
+    int c;
+    while (1)
+    {
+        static struct option long_options[] =
+                {
+                        {"output",      required_argument,  0,  'o'},
+                        {"confidence",  required_argument,  0,  'z'},
+                        {"help",        no_argument,        0,  'h'},
+                        {0, 0, 0, 0}
+                };
+
+        int option_index = 0;
+        c = getopt_long(argc, argv, "ho:z:", long_options, &option_index);
+
+        if (c == -1)
+            break;
+
+        switch (c)
+        {
+            case 'o':
+                strcpy(filename, optarg);
+                break;
+
+            case 'z':
+                confidence = strtod(optarg, NULL);
+                break;
+
+            case 'h':
+                printf("usage: %s [options] FILE.counts.csv...\n\n", argv[0]);
+                printf(BOLDMAGENTA "%20s" RESET "\n\t%s\n\n", "-o / --output FILENAME", "save the merged BER and PER in"
+                        " FILENAME (default merged.csv), one file per configuration when there are several.");
+                printf(BOLDMAGENTA "%20s" RESET "\n\t%s\n\n", "-z / --confidence FLOAT", "confidence level of the"
+                        " intervals, i.e. 0.95.");
+                exit(EXIT_SUCCESS);
+
+            default:
+                abort();
+        }
+    }
+
+    if (optind >= argc){
+        printf(BOLDRED "No counters file to merge.\n" RESET);
+        exit(EXIT_FAILURE);
+    }
+
+    t_mergepoint *points = NULL;
+    int points_count = 0;
+    int sources_count = argc - optind;
+    t_mergesource *sources = malloc(sources_count * sizeof *sources);
+
+    for (int f = 0; f < sources_count; f++) {
+        char *input = argv[optind + f];
+        int rows = merge_file(input, &points, &points_count, &sources[f]);
+        if (rows < 0){
+            printf(BOLDRED "Couldn't read \'%s\' or its points do not match the previous files.\n" RESET, input);
+            exit(EXIT_FAILURE);
+        }
+
+        // without rows there is no seed and shard to check for overlaps
+        if (!rows){
+            printf(BOLDRED "\'%s\' has no counters.\n" RESET, input);
+            exit(EXIT_FAILURE);
+        }
+
+        // inputs with the same seed must be distinct shards of the same partition,
+        // or they would count the same packets twice
+        for (int g = 0; g < f; g++) {
+            if (sources[g].seed != sources[f].seed)
+                continue;
+            if (sources[g].shards != sources[f].shards || sources[g].shard == sources[f].shard){
+                printf(BOLDRED "\'%s\' overlaps with \'%s\': same seed, shard %d/%d and %d/%d.\n" RESET, input,
+                       argv[optind + g], sources[f].shard, sources[f].shards, sources[g].shard, sources[g].shards);
+                exit(EXIT_FAILURE);
+            }
+        }
+    }
+
+    qsort(points, points_count, sizeof *points, mergepoint_compare);
+
+    int configs_count = 0;
+    for (int i = 0; i < points_count; i++)
+        configs_count += !i || strcmp(points[i].name, points[i - 1].name);
+
+    // one table per configuration
+    for (int first = 0; first < points_count;) {
+        int last = first;
+        while (last < points_count && !strcmp(points[last].name, points[first].name))
+            last++;
+        int length = last - first;
+
+        char config_filename[PATH_MAX];
+        strcpy(config_filename, filename);
+        if (configs_count > 1) {
+            char *extension = strrchr(filename, '.');
+            int stem = extension ? (int)(extension - filename) : (int) strlen(filename);
+            snprintf(config_filename, sizeof(config_filename), "%.*s_%s%s", stem, filename, points[first].name,
+                     extension ? extension : "");
+        }
+
+        FILE *file = fopen(config_filename, "w");
+        if (!file){
+            perror("Something went wrong. Couldn't create output file");
+            exit(EXIT_FAILURE);
+        }
+
+        double *columns[11];
+        for (int k = 0; k < 11; k++)
+            columns[k] = malloc(length * sizeof(double));
+
+        int pruned = 0;
+        for (int i = 0; i < length; i++) {
+            t_mergepoint *m = &points[first + i];
+            t_estimate e = simulation_estimate(&m->point, m->info_length, confidence);
+            columns[0][i] = m->point.EbN0_dB;
+            columns[1][i] = e.BER;
+            columns[2][i] = e.PER;
+            columns[3][i] = e.BER_low;
+            columns[4][i] = e.BER_high;
+            columns[5][i] = e.PER_low;
+            columns[6][i] = e.PER_high;
+            columns[7][i] = m->point.processed_packets;
+            columns[8][i] = m->point.pruned_packets;
+            columns[9][i] = m->point.checked_packets;
+            columns[10][i] = m->point.violations;
+            pruned = pruned || m->point.pruned_packets || m->point.checked_packets;
+        }
+
+        char *headers[] = {"EbN0", "BER", "PER", "BER_low", "BER_high", "PER_low", "PER_high", "packets",
+                           "pruned", "checked", "violations"};
+        save_table(columns, headers, pruned ? 11 : 8, length, file);
+        fclose(file);
+
+        if (configs_count > 1)
+            printf(BOLDMAGENTA "\n%s\n" RESET, points[first].name);
+
+        printf(BOLDYELLOW "%20s%20s%28s%20s%28s%12s\n" RESET, "EbN0 [dB]", "BER", "BER interval", "PER",
+               "PER interval", "packets");
+        for (int j = 0; j < length; ++j)
+            printf("%20f%20.4e  [%.4e, %.4e]%20.4e  [%.4e, %.4e]%12.0f\n", columns[0][j], columns[1][j],
+                   columns[3][j], columns[4][j], columns[2][j], columns[5][j], columns[6][j], columns[7][j]);
+
+        for (int k = 0; k < 11; k++)
+            free(columns[k]);
+        first = last;
+    }
+
+    printf(BOLDGREEN "\nMerged %d files, results saved in %s\n" RESET, sources_count, filename);
+
+    free(points);
+    free(sources);
+
+    return 0;
+}
@@ -0,0 +1,304 @@
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "perfcounters.h"
+#include "colors.h"
+
+#ifdef __linux__
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
+
+// counters and totals of a single thread, linked in a global list when first used
+typedef struct str_perfthread{
+    t_perfcounters counters;
+    t_perfkernel kernels[PERF_KERNELS];
+    struct str_perfthread *next;
+} t_perfthread;
+
+static char *event_names[PERF_EVENTS] = {
+        "cycles",
+        "instructions",
+        "l1d_misses",
+        "l2_misses",
+        "llc_misses",
+        "branch_misses",
+};
+
+static char *kernel_names[PERF_KERNELS] = {
+        "convcode_extrinsic",
+        "convcode_decode",
+        "interleave",
+        "deinterleave",
+};
+
+int perf_kernels_enabled = 0;
+static int available[PERF_EVENTS];
+
+static __thread t_perfthread *local = NULL;
+static t_perfthread *threads = NULL;
+
+char *perf_event_name(t_perf_event event)
+{
+    return event_names[event];
+}
+
+char *perf_kernel_name(t_perf_kernel kernel)
+{
+    return kernel_names[kernel];
+}
+
+#ifdef __linux__
+
+static int event_open(t_perf_event event, int group)
+{
+    struct perf_event_attr attr;/*{{{*/
+    memset(&attr, 0, sizeof attr);
+    attr.size = sizeof attr;
+    attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+    // user space only, so that perf_event_paranoid up to 2 is enough
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+
+    switch (event) {
+        case PERF_CYCLES:
+            attr.type = PERF_TYPE_HARDWARE;
+            attr.config = PERF_COUNT_HW_CPU_CYCLES;
+            break;
+
+        case PERF_INSTRUCTIONS:
+            attr.type = PERF_TYPE_HARDWARE;
+            attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+            break;
+
+        case PERF_L1D_MISSES:
+            attr.type = PERF_TYPE_HW_CACHE;
+            attr.config = PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                          (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+            break;
+
+        case PERF_L2_MISSES: {
+            // the L2 event is model specific, i.e. 0x3f24 (L2_RQSTS.MISS) on Skylake
+            char *raw = getenv("DEEPSPACE_PERF_L2");
+            if (!raw)
+                return -1;
+            attr.type = PERF_TYPE_RAW;
+            attr.config = strtoull(raw, NULL, 0);
+            break;
+        }
+
+        case PERF_LLC_MISSES:
+            attr.type = PERF_TYPE_HW_CACHE;
+            attr.config = PERF_COUNT_HW_CACHE_LL | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                          (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+            break;
+
+        case PERF_BRANCH_MISSES:
+            attr.type = PERF_TYPE_HARDWARE;
+            attr.config = PERF_COUNT_HW_BRANCH_MISSES;
+            break;
+
+        default:
+            return -1;
+    }
+
+    // calling thread, any cpu
+    return (int) syscall(__NR_perf_event_open, &attr, 0, -1, group, 0);/*}}}*/
+}
+
+int perf_open(t_perfcounters *counters)
+{
+    counters->leader = -1;/*{{{*/
+    counters->opened = 0;
+
+    // events the PMU cannot count are left out of the group
+    for (int e = 0; e < PERF_EVENTS; e++) {
+        counters->fd[e] = event_open(e, counters->leader);
+        counters->index[e] = -1;
+        if (counters->fd[e] < 0)
+            continue;
+
+        if (counters->leader < 0)
+            counters->leader = counters->fd[e];
+        counters->index[e] = counters->opened++;
+    }
+
+    return counters->opened;/*}}}*/
+}
+
+int perf_read(t_perfcounters *counters, uint64_t values[PERF_EVENTS])
+{
+    // nr, time enabled, time running, then one value per event/*{{{*/
+    uint64_t buffer[3 + PERF_EVENTS];
+
+    if (counters->leader < 0 || read(counters->leader, buffer, sizeof buffer) < (ssize_t) (3 * sizeof(uint64_t))) {
+        memset(values, 0, PERF_EVENTS * sizeof *values);
+        return -1;
+    }
+
+    // scale up if the group was multiplexed with other users of the PMU
+    double scale = buffer[2] ? (double) buffer[1] / buffer[2] : 1;
+    for (int e = 0; e < PERF_EVENTS; e++)
+        values[e] = counters->index[e] < 0 ? 0 : (uint64_t) (buffer[3 + counters->index[e]] * scale);
+
+    return 0;/*}}}*/
+}
+
+void perf_close(t_perfcounters *counters)
+{
+    for (int e = 0; e < PERF_EVENTS; e++) {/*{{{*/
+        if (counters->fd[e] >= 0)
+            close(counters->fd[e]);
+        counters->fd[e] = -1;
+    }
+    counters->leader = -1;
+    counters->opened = 0;/*}}}*/
+}
+
+#else
+
+// perf_event_open is Linux only: no counter is ever available
+int perf_open(t_perfcounters *counters)
+{
+    counters->leader = -1;
+    counters->opened = 0;
+    for (int e = 0; e < PERF_EVENTS; e++) {
+        counters->fd[e] = -1;
+        counters->index[e] = -1;
+    }
+    return 0;
+}
+
+int perf_read(t_perfcounters *counters, uint64_t values[PERF_EVENTS])
+{
+    memset(values, 0, PERF_EVENTS * sizeof *values);
+    return -1;
+}
+
+void perf_close(t_perfcounters *counters)
+{
+}
+
+#endif
+
+int perf_kernels_enable(void)
+{
+    // probe the events on the calling thread/*{{{*/
+    t_perfcounters probe;
+    int opened = perf_open(&probe);
+    for (int e = 0; e < PERF_EVENTS; e++)
+        available[e] = probe.fd[e] >= 0;
+    perf_close(&probe);
+
+    perf_kernels_enabled = opened > 0;
+    return opened;/*}}}*/
+}
+
+void perf_kernel_begin(uint64_t start[PERF_EVENTS])
+{
+    if (!local) {/*{{{*/
+        local = calloc(1, sizeof *local);
+        perf_open(&local->counters);
+
+        #pragma omp critical(perfcounters)
+        {
+            local->next = threads;
+            threads = local;
+        }
+    }
+
+    perf_read(&local->counters, start);/*}}}*/
+}
+
+void perf_kernel_end(t_perf_kernel kernel, uint64_t start[PERF_EVENTS], double edges, double bits)
+{
+    uint64_t end[PERF_EVENTS];/*{{{*/
+    perf_read(&local->counters, end);
+
+    t_perfkernel *totals = &local->kernels[kernel];
+    for (int e = 0; e < PERF_EVENTS; e++)
+        totals->values[e] += end[e] - start[e];
+    totals->calls++;
+    totals->edges += edges;
+    totals->bits += bits;/*}}}*/
+}
+
+void perf_kernel_totals(t_perf_kernel kernel, t_perfkernel *totals)
+{
+    memset(totals, 0, sizeof *totals);/*{{{*/
+
+    #pragma omp critical(perfcounters)
+    for (t_perfthread *t = threads; t; t = t->next) {
+        t_perfkernel *k = &t->kernels[kernel];
+        totals->calls += k->calls;
+        totals->edges += k->edges;
+        totals->bits += k->bits;
+        for (int e = 0; e < PERF_EVENTS; e++)
+            totals->values[e] += k->values[e];
+    }/*}}}*/
+}
+
+// per-unit value of an event, NaN if the event is not counted
+static double per_unit(t_perfkernel *totals, t_perf_event event, double units)
+{
+    return (available[event] && units > 0) ? totals->values[event] / units : NAN;
+}
+
+void perf_kernels_print(void)
+{
+    printf(BOLDYELLOW "%-20s%12s%8s%14s%14s%14s%14s%14s%14s\n" RESET, "kernel", "calls", "IPC", "cycles/edge",/*{{{*/
+           "cycles/bit", "L1D miss/bit", "L2 miss/bit", "LLC miss/bit", "br miss/bit");
+
+    for (int k = 0; k < PERF_KERNELS; k++) {
+        t_perfkernel totals;
+        perf_kernel_totals(k, &totals);
+        if (!totals.calls)
+            continue;
+
+        double ipc = (available[PERF_CYCLES] && available[PERF_INSTRUCTIONS] && totals.values[PERF_CYCLES]) ?
+                     (double) totals.values[PERF_INSTRUCTIONS] / totals.values[PERF_CYCLES] : NAN;
+
+        printf("%-20s%12llu%8.2f%14.3f%14.3f%14.4f%14.4f%14.4f%14.4f\n", kernel_names[k],
+               (unsigned long long) totals.calls, ipc, per_unit(&totals, PERF_CYCLES, totals.edges),
+               per_unit(&totals, PERF_CYCLES, totals.bits), per_unit(&totals, PERF_L1D_MISSES, totals.bits),
+               per_unit(&totals, PERF_L2_MISSES, totals.bits), per_unit(&totals, PERF_LLC_MISSES, totals.bits),
+               per_unit(&totals, PERF_BRANCH_MISSES, totals.bits));
+    }/*}}}*/
+}
+
+int perf_kernels_save(char *filename)
+{
+    FILE *file = fopen(filename, "w");/*{{{*/
+    if (!file)
+        return -1;
+
+    fprintf(file, "kernel,calls,edges,bits");
+    for (int e = 0; e < PERF_EVENTS; e++)
+        fprintf(file, ",%s", event_names[e]);
+    fprintf(file, ",cycles_per_edge,cycles_per_bit,l1d_misses_per_bit,l2_misses_per_bit,llc_misses_per_bit,"
+            "branch_misses_per_bit\n");
+
+    for (int k = 0; k < PERF_KERNELS; k++) {
+        t_perfkernel totals;
+        perf_kernel_totals(k, &totals);
+
+        fprintf(file, "%s,%llu,%.0f,%.0f", kernel_names[k], (unsigned long long) totals.calls, totals.edges,
+                totals.bits);
+        for (int e = 0; e < PERF_EVENTS; e++) {
+            if (available[e])
+                fprintf(file, ",%llu", (unsigned long long) totals.values[e]);
+            else
+                fprintf(file, ",nan");
+        }
+        fprintf(file, ",%.6g,%.6g,%.6g,%.6g,%.6g,%.6g\n", per_unit(&totals, PERF_CYCLES, totals.edges),
+                per_unit(&totals, PERF_CYCLES, totals.bits), per_unit(&totals, PERF_L1D_MISSES, totals.bits),
+                per_unit(&totals, PERF_L2_MISSES, totals.bits), per_unit(&totals, PERF_LLC_MISSES, totals.bits),
+                per_unit(&totals, PERF_BRANCH_MISSES, totals.bits));
+    }
+
+    fclose(file);
+    return 0;/*}}}*/
+}
@@ -0,0 +1,64 @@
+#ifndef DEEPSPACE_TURBO_PERFCOUNTERS_H
+#define DEEPSPACE_TURBO_PERFCOUNTERS_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+// hardware events sampled with perf_event_open
+typedef enum {
+    PERF_CYCLES,
+    PERF_INSTRUCTIONS,
+    PERF_L1D_MISSES,
+    PERF_L2_MISSES,     // no generic perf event: raw code from DEEPSPACE_PERF_L2, if set
+    PERF_LLC_MISSES,
+    PERF_BRANCH_MISSES,
+    PERF_EVENTS
+} t_perf_event;
+
+// decoder kernels sampled when perf_kernels_enabled is set
+typedef enum {
+    PERF_KERNEL_CONVCODE_EXTRINSIC,
+    PERF_KERNEL_CONVCODE_DECODE,
+    PERF_KERNEL_INTERLEAVE,
+    PERF_KERNEL_DEINTERLEAVE,
+    PERF_KERNELS
+} t_perf_kernel;
+
+// group of counters of the calling thread; fd is -1 for unavailable events
+typedef struct str_perfcounters{
+    int leader;
+    int fd[PERF_EVENTS];
+    int index[PERF_EVENTS];     // position of the event in a group read
+    int opened;
+} t_perfcounters;
+
+// totals of a kernel over all the threads
+typedef struct str_perfkernel{
+    uint64_t calls;
+    uint64_t values[PERF_EVENTS];
+    double edges;               // trellis edges, one per branch of each trellis section
+    double bits;                // decoded (or permuted) bits
+} t_perfkernel;
+
+int perf_open(t_perfcounters *counters);
+int perf_read(t_perfcounters *counters, uint64_t values[PERF_EVENTS]);
+void perf_close(t_perfcounters *counters);
+char *perf_event_name(t_perf_event event);
+char *perf_kernel_name(t_perf_kernel kernel);
+
+// kernel sampling: the library calls these around convcode_extrinsic,
+// convcode_decode and the interleaver passes
+extern int perf_kernels_enabled;
+int perf_kernels_enable(void);
+void perf_kernel_begin(uint64_t start[PERF_EVENTS]);
+void perf_kernel_end(t_perf_kernel kernel, uint64_t start[PERF_EVENTS], double edges, double bits);
+void perf_kernel_totals(t_perf_kernel kernel, t_perfkernel *totals);
+void perf_kernels_print(void);
+int perf_kernels_save(char *filename);
+
+#define PERF_KERNEL_BEGIN(kernel) uint64_t perf_start_##kernel[PERF_EVENTS]; \
+    if (perf_kernels_enabled) perf_kernel_begin(perf_start_##kernel)
+#define PERF_KERNEL_END(kernel, edges, bits) \
+    if (perf_kernels_enabled) perf_kernel_end(kernel, perf_start_##kernel, edges, bits)
+
+#endif //DEEPSPACE_TURBO_PERFCOUNTERS_H
@@ -0,0 +1,115 @@
+#include "profiling.h"
+
+#ifdef DEEPSPACE_PROFILE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+// counters of a single thread, linked in a global list when first used
+typedef struct str_profile{
+    uint64_t ticks[PROFILE_STAGES];
+    uint64_t calls[PROFILE_STAGES];
+    struct str_profile *next;
+} t_profile;
+
+static char *stage_names[PROFILE_STAGES] = {
+        "packet_generation",
+        "encode",
+        "noise_generation",
+        "modulation",
+        "serial_to_parallel",
+        "bcjr_backward",
+        "bcjr_forward",
+        "bcjr_extrinsic",
+        "interleave",
+        "deinterleave",
+};
+
+static __thread t_profile *local = NULL;
+static t_profile *profiles = NULL;
+
+// reference points to convert ticks to seconds
+static uint64_t start_ticks = 0;
+static struct timespec start_time;
+
+static uint64_t clock_ns(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t) now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+
+uint64_t profile_ticks(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return clock_ns();
+#endif
+}
+
+void profile_add(t_profile_stage stage, uint64_t ticks)
+{
+    if (!local) {/*{{{*/
+        local = calloc(1, sizeof *local);
+
+        #pragma omp critical(profile)
+        {
+            if (!profiles) {
+                start_ticks = profile_ticks();
+                clock_gettime(CLOCK_MONOTONIC, &start_time);
+            }
+            local->next = profiles;
+            profiles = local;
+        }
+    }
+
+    local->ticks[stage] += ticks;
+    local->calls[stage]++;/*}}}*/
+}
+
+int profile_save(char *filename)
+{
+    FILE *file = fopen(filename, "w");/*{{{*/
+    if (!file)
+        return -1;
+
+    // estimate the tick rate over the whole run
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    double elapsed = (now.tv_sec - start_time.tv_sec) + 1e-9 * (now.tv_nsec - start_time.tv_nsec);
+    double ticks_per_second = elapsed > 0 ? (profile_ticks() - start_ticks) / elapsed : 1e9;
+
+    uint64_t ticks[PROFILE_STAGES] = {0};
+    uint64_t calls[PROFILE_STAGES] = {0};
+    int threads = 0;
+
+    fprintf(file, "{\n  \"ticks_per_second\": %.0f,\n  \"threads\": [\n", ticks_per_second);
+    for (t_profile *p = profiles; p; p = p->next) {
+        fprintf(file, "%s    {", threads++ ? ",\n" : "");
+        for (int s = 0; s < PROFILE_STAGES; s++) {
+            fprintf(file, "%s\"%s\": {\"calls\": %llu, \"ticks\": %llu}", s ? ", " : "", stage_names[s],
+                    (unsigned long long) p->calls[s], (unsigned long long) p->ticks[s]);
+            ticks[s] += p->ticks[s];
+            calls[s] += p->calls[s];
+        }
+        fprintf(file, "}");
+    }
+
+    fprintf(file, "\n  ],\n  \"stages\": {\n");
+    for (int s = 0; s < PROFILE_STAGES; s++) {
+        fprintf(file, "    \"%s\": {\"calls\": %llu, \"ticks\": %llu, \"seconds\": %.6f, \"ticks_per_call\": %.1f}%s\n",
+                stage_names[s], (unsigned long long) calls[s], (unsigned long long) ticks[s],
+                ticks[s] / ticks_per_second, calls[s] ? (double) ticks[s] / calls[s] : 0, s < PROFILE_STAGES - 1 ? "," : "");
+    }
+    fprintf(file, "  }\n}\n");
+
+    fclose(file);
+    return 0;/*}}}*/
+}
+
+#endif
@@ -0,0 +1,38 @@
+#ifndef DEEPSPACE_TURBO_PROFILING_H
+#define DEEPSPACE_TURBO_PROFILING_H
+
+#include <stdint.h>
+
+// hot-path stages, timed when compiled with DEEPSPACE_PROFILE
+typedef enum {
+    PROFILE_PACKET_GENERATION,
+    PROFILE_ENCODE,
+    PROFILE_NOISE_GENERATION,
+    PROFILE_MODULATION,
+    PROFILE_SERIAL_TO_PARALLEL,
+    PROFILE_BCJR_BACKWARD,
+    PROFILE_BCJR_FORWARD,
+    PROFILE_BCJR_EXTRINSIC,
+    PROFILE_INTERLEAVE,
+    PROFILE_DEINTERLEAVE,
+    PROFILE_STAGES
+} t_profile_stage;
+
+#ifdef DEEPSPACE_PROFILE
+
+uint64_t profile_ticks(void);
+void profile_add(t_profile_stage stage, uint64_t ticks);
+int profile_save(char *filename);
+
+#define PROFILE_BEGIN(stage) uint64_t profile_start_##stage = profile_ticks()
+#define PROFILE_END(stage) profile_add(stage, profile_ticks() - profile_start_##stage)
+
+#else
+
+// compiled out: no code is generated
+#define PROFILE_BEGIN(stage)
+#define PROFILE_END(stage)
+
+#endif
+
+#endif //DEEPSPACE_TURBO_PROFILING_H
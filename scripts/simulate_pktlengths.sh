@@ -47,26 +47,20 @@ echo "ITER: ${ITER}" >> $LOG
 echo "" >> $LOG
 echo "" >> $LOG
 
+# all the packet lengths are simulated in a single run, on the same packets and noise
+FILENAME="$DIR/${PKT_COUNT}pkts.csv"
+echo $FILENAME >> $LOG
+
+echo "Simulating with 1, 2, 4 and 5 octets..."
+/usr/bin/time -f "%E" -a -o $LOG ../bin/deepspace_turbo -y -m $MIN_SNR -M  $MAX_SNR -n $SNR_POINTS -i ${ITER} -o $FILENAME -c $PKT_COUNT -C $CORES -t ${CODE} -k 1,2,4,5
+echo "" >> $LOG
+echo "Done..."
+
 PARAMS=""
 for i in 1 2 4 5
 do
-
-    echo "Simulating with ${i} octets..."
-
-    # save results in the following file
-    FILENAME="$DIR/${PKT_COUNT}pkts_${i}octets.csv"
     LABEL="${i} octets"
-
-    echo $FILENAME >> $LOG
-    
-    PARAMS="$PARAMS $FILENAME \"${LABEL}\""
-
-    # run simulator
-    /usr/bin/time -f "%E" -a -o $LOG ../bin/deepspace_turbo -y -m $MIN_SNR -M  $MAX_SNR -n $SNR_POINTS -i ${ITER} -o $FILENAME -c $PKT_COUNT -C $CORES -t ${CODE} -k ${i}
-    
-    echo "" >> $LOG
-    echo "Done..."
-
+    PARAMS="$PARAMS $DIR/${PKT_COUNT}pkts_code${CODE}_k${i}.csv \"${LABEL}\""
 done
 
 PARAMS="$PARAMS $DIR/pktlenghts_plot.png"
@@ -3,6 +3,7 @@
 //
 
 #include "utilities.h"
+#include "cpudispatch.h"
 #include <stdlib.h>
 #include <math.h>
 
@@ -53,6 +54,98 @@ int* randbits(unsigned int length)
     return seq;/*}}}*/
 }
 
+static uint64_t splitmix64(uint64_t *x)
+{
+    uint64_t z = (*x += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+static uint64_t rotl(uint64_t x, int k)
+{
+    return (x << k) | (x >> (64 - k));
+}
+
+void rng_seed(t_rng *rng, uint64_t seed, uint64_t stream)
+{
+    // mix seed and stream index so that neighbouring streams are uncorrelated/*{{{*/
+    uint64_t x = seed ^ splitmix64(&stream);
+    for (int i = 0; i < 4; i++)
+        rng->state[i] = splitmix64(&x);/*}}}*/
+}
+
+uint64_t rng_next(t_rng *rng)
+{
+    uint64_t *s = rng->state;/*{{{*/
+    uint64_t result = rotl(s[1] * 5, 7) * 9;
+    uint64_t t = s[1] << 17;
+
+    s[2] ^= s[0];
+    s[3] ^= s[1];
+    s[1] ^= s[2];
+    s[0] ^= s[3];
+    s[2] ^= t;
+    s[3] = rotl(s[3], 45);
+
+    return result;/*}}}*/
+}
+
+double rng_uniform(t_rng *rng)
+{
+    // uniform in (0, 1], safe to pass to log()
+    return ((rng_next(rng) >> 11) + 1) * (1.0 / 9007199254740992.0);
+}
+
+double* randn_r(t_rng *rng, double mean, double variance, unsigned int length)
+{
+    double* random =  malloc(length * sizeof *random);/*{{{*/
+    rng_fill_normal(rng, random, mean, variance, length);
+
+    return random;/*}}}*/
+}
+
+int* randbits_r(t_rng *rng, unsigned int length)
+{
+    int *seq = malloc(length*sizeof *seq);/*{{{*/
+    rng_fill_bits(rng, seq, length);
+
+    return seq;/*}}}*/
+}
+
+static ISA_BODY void rng_fill_normal_body(t_rng *rng, double *random, double mean, double variance,
+                                          unsigned int length)
+{
+    // Box-Muller: use both outputs of each transformation/*{{{*/
+    for (int i = 0; i < length; i += 2)
+    {
+        double R = sqrt(-2*variance*log(rng_uniform(rng)));
+        double theta = 2*M_PI*rng_uniform(rng);
+
+        random[i] = mean + R*cos(theta);
+        if (i + 1 < length)
+            random[i+1] = mean + R*sin(theta);
+    }/*}}}*/
+}
+
+ISA_DISPATCH_VOID(, rng_fill_normal, (t_rng *rng, double *random, double mean, double variance, unsigned int length),
+                  (rng, random, mean, variance, length))
+
+static ISA_BODY void rng_fill_bits_body(t_rng *rng, int *seq, unsigned int length)
+{
+    uint64_t bits = 0;/*{{{*/
+    for (int i = 0; i < length; i++)
+    {
+        if (!(i % 64))
+            bits = rng_next(rng);
+
+        seq[i] = bits & 1;
+        bits >>= 1;
+    }/*}}}*/
+}
+
+ISA_DISPATCH_VOID(, rng_fill_bits, (t_rng *rng, int *seq, unsigned int length), (rng, seq, length))
+
 double* linspace(double start, double end, unsigned int size)
 {
     double *array =  malloc(size * sizeof *array);/*{{{*/
@@ -112,6 +205,73 @@ int save_data(double *x, double *y, double *z, char *header[], unsigned int leng
         fprintf(file, "%.12f,%.12f,%.12f\n", x[i], y[i], z[i]);/*}}}*/
 }
 
+int save_table(double **columns, char *header[], unsigned int columns_count, unsigned int length, FILE *file)
+{
+    // write headers/*{{{*/
+    for (int c = 0; c < columns_count; c++)
+        fprintf(file, "%s%c", header[c], c == columns_count - 1 ? '\n' : ',');
+
+    for (int i = 0; i < length; i++)
+        for (int c = 0; c < columns_count; c++)
+            fprintf(file, "%.12g%c", columns[c][i], c == columns_count - 1 ? '\n' : ',');
+
+    return 0;/*}}}*/
+}
+
+double normal_quantile(double p)
+{
+    // Acklam's rational approximation of the inverse normal CDF (rel. error < 1.2e-9)/*{{{*/
+    static const double a[] = {-3.969683028665376e+01, 2.209460984245205e+02, -2.759285104469687e+02,
+                               1.383577518672690e+02, -3.066479806614716e+01, 2.506628277459239e+00};
+    static const double b[] = {-5.447609879822406e+01, 1.615858368580409e+02, -1.556989798598866e+02,
+                               6.680131188771972e+01, -1.328068155288572e+01};
+    static const double c[] = {-7.784894002430293e-03, -3.223964580411365e-01, -2.400758277161838e+00,
+                               -2.549732539343734e+00, 4.374664141464968e+00, 2.938163982698783e+00};
+    static const double d[] = {7.784695709041462e-03, 3.224671290700398e-01, 2.445134137142996e+00,
+                               3.754408661907416e+00};
+    double p_low = 0.02425;
+
+    if (p <= 0)
+        return -HUGE_VAL;
+    if (p >= 1)
+        return HUGE_VAL;
+
+    if (p < p_low) {
+        double q = sqrt(-2*log(p));
+        return (((((c[0]*q + c[1])*q + c[2])*q + c[3])*q + c[4])*q + c[5]) /
+               ((((d[0]*q + d[1])*q + d[2])*q + d[3])*q + 1);
+    }
+
+    if (p > 1 - p_low) {
+        double q = sqrt(-2*log(1 - p));
+        return -(((((c[0]*q + c[1])*q + c[2])*q + c[3])*q + c[4])*q + c[5]) /
+                ((((d[0]*q + d[1])*q + d[2])*q + d[3])*q + 1);
+    }
+
+    double q = p - 0.5;
+    double r = q*q;
+    return (((((a[0]*r + a[1])*r + a[2])*r + a[3])*r + a[4])*r + a[5])*q /
+           (((((b[0]*r + b[1])*r + b[2])*r + b[3])*r + b[4])*r + 1);/*}}}*/
+}
+
+void wilson_interval(long int successes, long int trials, double z, double *low, double *high)
+{
+    if (trials <= 0) {/*{{{*/
+        *low = 0;
+        *high = 1;
+        return;
+    }
+
+    double n = (double) trials;
+    double p = successes / n;
+    double denominator = 1 + z*z/n;
+    double center = (p + z*z/(2*n)) / denominator;
+    double half_width = z*sqrt(p*(1 - p)/n + z*z/(4*n*n)) / denominator;
+
+    *low = (successes && center - half_width > 0) ? center - half_width : 0;
+    *high = center + half_width < 1 ? center + half_width : 1;/*}}}*/
+}
+
 double max_array(double *array, int size)
 {
     double max = array[0];
@@ -120,3 +280,20 @@ double max_array(double *array, int size)
 
     return max;
 }
+
+// parse a comma-separated list of integers, return the number of values read
+int parse_list(char *str, int *values, int max_values)
+{
+    int count = 0;
+    char *end = str;
+
+    while (*end && count < max_values) {
+        values[count++] = (int) strtol(end, &end, 10);
+        if (*end == ',')
+            end++;
+        else
+            break;
+    }
+
+    return count;
+}
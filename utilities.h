@@ -6,6 +6,14 @@
 #define DEEPSPACE_TURBO_UTILITIES_H
 
 #include<stdio.h>
+#include<stdint.h>
+
+// xoshiro256** generator: every packet gets its own stream so that results do not
+// depend on which thread processes it
+typedef struct str_rng{
+    uint64_t state[4];
+} t_rng;
+
 void print_array_int(int *array, int length);
 
 void print_array(double *array, int length);
@@ -14,6 +22,20 @@ double* randn(double mean, double variance, unsigned int length);
 
 int* randbits(unsigned int length);
 
+void rng_seed(t_rng *rng, uint64_t seed, uint64_t stream);
+
+uint64_t rng_next(t_rng *rng);
+
+double rng_uniform(t_rng *rng);
+
+double* randn_r(t_rng *rng, double mean, double variance, unsigned int length);
+
+int* randbits_r(t_rng *rng, unsigned int length);
+
+void rng_fill_normal(t_rng *rng, double *random, double mean, double variance, unsigned int length);
+
+void rng_fill_bits(t_rng *rng, int *seq, unsigned int length);
+
 double* linspace(double start, double end, unsigned int size);
 
 double* add_arrays(double *one, double *two, unsigned int length);
@@ -24,6 +46,14 @@ double *scalar_multiply(double *array, unsigned int length, double scalar);
 
 int save_data(double *x, double *y, double *z, char *header[], unsigned int length, FILE *file);
 
+int save_table(double **columns, char *header[], unsigned int columns_count, unsigned int length, FILE *file);
+
+double normal_quantile(double p);
+
+void wilson_interval(long int successes, long int trials, double z, double *low, double *high);
+
 double max_array(double *array, int size);
 
+int parse_list(char *str, int *values, int max_values);
+
 #endif //DEEPSPACE_TURBO_UTILITIES_H